@@ -0,0 +1,46 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "colors.h"
+
+/* Grid stored color by color: for each color and each row, a mask of the
+ * columns where the color may still go. A unit is scanned with a few
+ * bitwise operations instead of one word per cell. Grids up to 64x64.
+ * The bitboard is a front end of the propagation only: a grid is loaded,
+ * propagated and stored back, and the search goes on with grid_t. */
+typedef struct {
+  size_t size;
+  size_t size_sqrt;
+  uint64_t full;    /* Columns of a row */
+  uint64_t *planes; /* planes[color_id * size + row] */
+  uint64_t *placed; /* Columns of each row whose color was propagated */
+} bitboard_t;
+
+/* Allocate an empty bitboard of size*size cells, NULL on failure or above
+ * 64x64 */
+bitboard_t *bitboard_alloc(const size_t size);
+
+/* Free the bitboard */
+void bitboard_free(bitboard_t *bitboard);
+
+/* Load the colors of the cells, given row by row */
+void bitboard_load(bitboard_t *bitboard, const colors_t *cells);
+
+/* Store the colors of the cells, row by row */
+void bitboard_store(const bitboard_t *bitboard, colors_t *cells);
+
+/**
+ * Apply cross-hatching, lone numbers and, if asked, locked candidates
+ * (pointing and claiming) until a fixpoint, as grid_heuristics() does
+ * without the subsets and fishes. Return:
+ * + 0: if the grid is not solved but still consistent
+ * + 1: if the grid is solved
+ * + 2: if the grid is inconsistent
+ * */
+size_t bitboard_heuristics(bitboard_t *bitboard, bool use_locked_candidates);
+
+#endif /* BITBOARD_H */
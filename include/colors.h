@@ -1,13 +1,23 @@
 #ifndef COLORS_H
 #define COLORS_H
 
-#define MAX_COLORS 64
+#define DEFAULT_SUBSET_ORDER 4
 
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "prng.h"
+
+#ifdef COLORS_WIDE
+/* The wide build (sudoku-wide) holds the colors of the grids above 64x64 in
+ * two words, the compiler keeps the operators on them branch-free */
+#define MAX_COLORS 128
+__extension__ typedef unsigned __int128 colors_t;
+#else
+#define MAX_COLORS 64
 typedef uint64_t colors_t;
+#endif
 
 /* Initialize and return colors with given size */
 colors_t colors_full(const size_t size);
@@ -64,8 +74,8 @@ colors_t colors_rightmost(const colors_t colors);
 /* Returns the rightmost color of the set */
 colors_t colors_leftmost(const colors_t colors);
 
-/* Returns a random color chosen from the color set */
-colors_t colors_random(colors_t colors);
+/* Returns a random color chosen from the color set, drawn from `prng` */
+colors_t colors_random(colors_t colors, prng_t *prng);
 
 /* Apply cross_hatching heuristic on the subgrid */
 bool cross_hatching(colors_t *subgrid[], size_t size);
@@ -73,7 +83,27 @@ bool cross_hatching(colors_t *subgrid[], size_t size);
 /* Apply lone_number heuristic on the subgrid */
 bool lone_number(colors_t *subgrid[], size_t size);
 
-/* Returns True if heuristics has been applied on grid, False otherwise */
-bool subgrid_heuristics(colors_t *subgrid[], size_t size);
+/* Set the largest naked and hidden subsets looked for (pairs are 2) */
+void subset_set_max_order(const size_t order);
+
+/* Apply naked_subset heuristic on the subgrid */
+bool naked_subset(colors_t *subgrid[], size_t size);
+
+/* Apply hidden_subset heuristic on the subgrid */
+bool hidden_subset(colors_t *subgrid[], size_t size);
+
+/* Use all_different() in grid_heuristics() instead of the subsets, and
+ * all_different_check() in the consistency checks of the units */
+void all_different_set_enabled(const bool enabled);
+
+/* Return True if all_different() replaces the subsets */
+bool all_different_is_enabled(void);
+
+/* Return True if every cell of the subgrid can get a different color */
+bool all_different_check(colors_t *subgrid[], size_t size);
+
+/* Remove the colors that are part of no perfect matching between the cells
+ * and the colors of the subgrid, return True if some were removed */
+bool all_different(colors_t *subgrid[], size_t size);
 
 #endif /* COLORS_H */
\ No newline at end of file
@@ -1,13 +1,32 @@
 #ifndef GRID_H
 #define GRID_H
 
-#define MAX_GRID_SIZE 64
+#ifdef COLORS_WIDE
+#define MAX_GRID_SIZE 100
+#else
+#define MAX_GRID_SIZE 64 /* 81x81 and 100x100 are left to sudoku-wide */
+#endif
+#define GRID_SIZES "1, 4, 9, 16, 25, 36, 49, 64, 81, 100"
+#define MAX_CHAR_GRID_SIZE 64 /* Larger grids write their colors as numbers */
+#define DEFAULT_FISH_ORDER 4
+#define DEFAULT_CHAIN_LENGTH 0
+#define MAX_CHAIN_LENGTH 255
+#define DEFAULT_CHAIN_BUDGET 2.0
+#define DEFAULT_PROBE_BUDGET 128
 #define EMPTY_CELL '_'
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "colors.h"
+#include "prng.h"
+
+/* Characters of the colors of the grids up to MAX_CHAR_GRID_SIZE. The
+ * larger grids need more colors than there are printable characters, their
+ * colors are the numbers from 1 to the size of the grid, separated by
+ * blanks, and '_' stays the empty cell. */
 static const char color_table[] = "123456789"
                                   "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
                                   "@"
@@ -19,6 +38,29 @@ typedef struct _grid_t grid_t;
 
 typedef struct choice_t choice_t;
 
+/* Techniques used by grid_rate(), from the easiest to the hardest */
+typedef enum {
+  technique_cross_hatching,
+  technique_lone_number,
+  technique_subsets,
+  technique_locked_candidates,
+  technique_guess
+} technique_t;
+
+/* Difficulty of a grid, as measured by grid_rate() */
+typedef struct {
+  technique_t hardest; /* Hardest technique needed to solve the grid */
+  size_t nb_guesses;   /* Number of choices tried when logic was stuck */
+} rating_t;
+
+/* Profiles of grid_heuristics(): every technique until none applies, or
+ * the techniques skipped while their eliminations cost more than branching,
+ * as measured during the solve */
+typedef enum { schedule_full, schedule_adaptive } schedule_t;
+
+/* Random schedule of the cells emptied by the generator */
+typedef struct removal_t removal_t;
+
 /* Allocate and return a pointer to an grid_t struct of size*size cells */
 grid_t *grid_alloc(size_t size);
 
@@ -37,6 +79,35 @@ size_t grid_get_size(const grid_t *grid);
 /* Writes the `grid` in the file descriptor `fd`. */
 void grid_print(const grid_t *grid, FILE *fd);
 
+/* Hash of the colors of the cells of a grid: `key` picks an entry of a
+ * table and `check` verifies it. Each color removed from a cell xors its own
+ * random words in both, so the hash follows the changes of the cells. */
+typedef struct {
+  uint64_t key;
+  uint64_t check;
+} grid_hash_t;
+
+/* Return the hash of the colors of every cell of `grid` */
+grid_hash_t grid_hash(const grid_t *grid);
+
+/* Copy the colors of the cells of `grid`, row by row, into `cells` */
+void grid_get_colors(const grid_t *grid, colors_t *cells);
+
+/* Set the colors of the cells of `grid` from `cells`, given row by row. Only
+ * the cells that differ update the hash. */
+void grid_set_colors(grid_t *grid, const colors_t *cells);
+
+/* Return the bytes a cell of a grid of `size` takes once packed by
+ * grid_pack(): 2 up to 16 colors, 4 up to 32 and a colors_t beyond */
+size_t grid_cell_bytes(const size_t size);
+
+/* Store the colors of the cells of `grid`, each one in grid_cell_bytes() */
+void grid_pack(const grid_t *grid, void *buffer);
+
+/* Set the colors of the cells of `grid` from a buffer filled by
+ * grid_pack(), as grid_set_colors() does */
+void grid_unpack(grid_t *grid, const void *buffer);
+
 /* Do a Deep copy of `grid` in a new memory area and return it */
 grid_t *grid_copy(const grid_t *grid);
 
@@ -44,20 +115,59 @@ grid_t *grid_copy(const grid_t *grid);
 char *grid_get_cell(const grid_t *grid, const size_t row, const size_t column);
 
 /* Set a grid cell to a specific value */
-void grid_set_cell(const grid_t *grid, const size_t row, const size_t column,
+void grid_set_cell(grid_t *grid, const size_t row, const size_t column,
                    const char color);
 
 /* Return True if grid is consistent, False otherwise */
 bool grid_is_consistent(grid_t *grid);
 
+/* Set the largest fishes looked for by grid_heuristics() (2 for X-Wings, 3 for
+ * Swordfishes, 4 for Jellyfishes, 0 to disable them) and whether finned
+ * fishes are looked for too */
+void grid_set_fish(const size_t max_order, const bool finned);
+
+/* Set the maximal number of links of the chains looked for by
+ * grid_heuristics() (0 to disable them, at most MAX_CHAIN_LENGTH) and the
+ * time in milliseconds they may take each time the other heuristics are
+ * stuck */
+void grid_set_chains(const size_t max_length, const double budget_ms);
+
+/* Set the profile of grid_heuristics() */
+void grid_set_schedule(const schedule_t profile);
+
+/* Forget what the adaptive profile measured in the calling thread, at the
+ * start of a solve */
+void grid_schedule_reset(void);
+
+/* Set the number of tentative assignments grid_probe() may try (0 disables
+ * it) */
+void grid_set_probe(const size_t budget);
+
+/* Try the colors of the cells with two or three colors one at a time and
+ * remove the ones whose propagation makes the grid inconsistent. Return True
+ * if some colors were removed */
+bool grid_probe(grid_t *grid);
+
 /**
- * Apply heuristics on grid and return:
+ * Apply heuristics on grid, from the cheapest to the most expensive, a
+ * technique being tried only once the cheaper ones are stuck. Return:
  * + 0: if the grid is not solved but still consistent
  * + 1: if the grid is solved
  * + 2: if the grid is inconsistent
  * */
 size_t grid_heuristics(grid_t *grid, bool use_locked_candidates);
 
+/**
+ * Solve `grid` in place like a human would, only moving to a harder technique
+ * when the easier ones are stuck, and record in `rating` what was needed.
+ * The rating stops as soon as a technique harder than `limit` is needed, in
+ * which case `rating->hardest` is above `limit`. Return:
+ * + 0: if the grid is not solved but still consistent
+ * + 1: if the grid is solved
+ * + 2: if the grid is inconsistent
+ * */
+size_t grid_rate(grid_t *grid, rating_t *rating, const technique_t limit);
+
 /* Free a choice_t data structure */
 void grid_choice_free(choice_t *choice);
 
@@ -67,6 +177,11 @@ bool grid_choice_is_empty(const choice_t *choice);
 /* Apply the choice to the given grid */
 void grid_choice_apply(grid_t *grid, const choice_t *choice);
 
+/* Apply the choice and remove its color from the row, column and block of
+ * the cell, and so on for the cells left with one color. Return False if a
+ * cell is emptied. */
+bool grid_choice_assign(grid_t *grid, const choice_t *choice);
+
 /* Blank (set to full colors) the given choice */
 void grid_choice_blank(grid_t *grid, const choice_t *choice);
 
@@ -82,17 +197,39 @@ choice_t *grid_choice(grid_t *grid);
 /* Do a deep copy of grid_b in grid_a */
 void grid_deep_copy(grid_t *grid_a, grid_t *grid_b);
 
-/* Return a new grid of specified size containing full colors except one cell */
-grid_t *get_new_grid(const size_t size);
+/* Return a new grid of specified size containing full colors except a random
+ * permutation of the colors on its first row */
+grid_t *get_new_grid(const size_t size, prng_t *prng);
+
+/* Return a solved grid of specified size without any search: the pattern
+ * (row % n * n + row / n + column) % size, n*n = size, whose rows within the
+ * bands, bands, columns within the stacks, stacks and colors are shuffled */
+grid_t *get_new_solved_grid(const size_t size, prng_t *prng);
 
 /* Remove randomly specified number of colors in the grid. Remove means to put
  * full colors.*/
-void remove_some_colors(grid_t *grid, size_t nb_colors_to_remove);
+void remove_some_colors(grid_t *grid, size_t nb_colors_to_remove,
+                        prng_t *prng);
+
+/* Allocate a removal schedule visiting every cell of `grid` once, in an
+ * order shuffled with `prng` */
+removal_t *grid_removal_alloc(const grid_t *grid, prng_t *prng);
+
+/* Free the memory of the removal schedule */
+void grid_removal_free(removal_t *removal);
+
+/* Remove the color of the next solved and not excluded cell of the schedule
+ * and return it as a choice. Return NULL once every cell has been tried. */
+choice_t *grid_removal_next(removal_t *removal, grid_t *grid);
+
+/* Put back the color removed by `choice` and exclude its cell from any
+ * further removal */
+void grid_removal_restore(removal_t *removal, grid_t *grid,
+                          const choice_t *choice);
 
-/* Remove randomly one color in the grid and return it. The cell from which the
- * color is removed must not be in 'tab'. For example, the cell [2][3] is stored
- * in 'tab' like this: 23 (2*10 + 3).
- */
-choice_t *remove_one_color(grid_t *grid, int *tab, size_t tab_size);
+/* Put back the color removed by `choice` and schedule its cell again, it will
+ * be the next one returned by grid_removal_next() */
+void grid_removal_retry(removal_t *removal, grid_t *grid,
+                        const choice_t *choice);
 
 #endif /* GRID_H */
\ No newline at end of file
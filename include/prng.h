@@ -0,0 +1,21 @@
+#ifndef PRNG_H
+#define PRNG_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* State of a xoshiro256** pseudo-random number generator */
+typedef struct {
+  uint64_t state[4];
+} prng_t;
+
+/* Seed `prng` from `seed` on the independent stream number `stream` */
+void prng_seed(prng_t *prng, const uint64_t seed, const uint64_t stream);
+
+/* Return the next 64 bits of the stream */
+uint64_t prng_next(prng_t *prng);
+
+/* Return a number uniformly drawn in [0, bound), 0 if bound is 0 */
+size_t prng_bounded(prng_t *prng, const size_t bound);
+
+#endif /* PRNG_H */
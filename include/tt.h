@@ -0,0 +1,40 @@
+#ifndef TT_H
+#define TT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Entry of the transposition table. The key and the check word of a state
+ * are stored xored with the data, so that an entry torn by concurrent
+ * writes is seen as a miss, and so is a state sharing only its key. */
+typedef struct {
+  _Atomic uint64_t key;   /* key ^ data */
+  _Atomic uint64_t check; /* check ^ data */
+  _Atomic uint64_t data;
+} tt_entry_t;
+
+/* Fixed-size transposition table, shared without locks between threads */
+typedef struct {
+  tt_entry_t *entries;
+  size_t mask; /* Number of entries minus one, a power of two */
+} tt_t;
+
+/* Allocate a table of at most `megabytes` MB, return NULL on failure */
+tt_t *tt_alloc(const size_t megabytes);
+
+/* Free the table */
+void tt_free(tt_t *tt);
+
+/* Store `data` for the state of `key` and `check`, replacing what was
+ * there */
+void tt_store(tt_t *tt, const uint64_t key, const uint64_t check,
+              const uint64_t data);
+
+/* Return True and set `data` if the state of `key` and `check` is in the
+ * table */
+bool tt_probe(const tt_t *tt, const uint64_t key, const uint64_t check,
+              uint64_t *data);
+
+#endif /* TT_H */
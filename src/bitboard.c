@@ -0,0 +1,443 @@
+#include "bitboard.h"
+
+#include <string.h>
+
+#define status_code_grid_is_not_solved_and_consistent 0
+#define status_code_grid_is_solved 1
+#define status_code_grid_is_inconsistent 2
+
+/* The masks of the bitboard are words, their helpers are kept here rather
+ * than going through the colors_t ones */
+
+/* Return the number of bits set in `mask` */
+static size_t mask_count(const uint64_t mask) {
+
+  uint64_t count = mask - ((mask >> 1) & 0x5555555555555555);
+  count = (count & 0x3333333333333333) + ((count >> 2) & 0x3333333333333333);
+  count = (count + (count >> 4)) & 0x0F0F0F0F0F0F0F0F;
+
+  return (size_t)((count * 0x0101010101010101) >> 56);
+}
+
+/* Return the lowest bit of `mask` */
+static uint64_t mask_rightmost(const uint64_t mask) {
+
+  return mask & (~mask + 1);
+}
+
+/* Return True if `mask` has exactly one bit */
+static bool mask_is_singleton(const uint64_t mask) {
+
+  return mask != 0 && (mask & (mask - 1)) == 0;
+}
+
+/* Return the `nb_bits` lowest bits */
+static uint64_t mask_full(const size_t nb_bits) {
+
+  return nb_bits >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << nb_bits) - 1;
+}
+
+/* Return the index of the single bit of `bit` */
+static size_t bit_index(const uint64_t bit) {
+
+  return mask_count(bit - 1);
+}
+
+/* Return the columns of the block containing `column` */
+static uint64_t block_columns(const bitboard_t *bitboard, const size_t column) {
+
+  size_t size_sqrt = bitboard->size_sqrt;
+  size_t column_start = (column / size_sqrt) * size_sqrt;
+
+  return mask_full(size_sqrt) << column_start;
+}
+
+bitboard_t *bitboard_alloc(const size_t size) {
+
+  if (size == 0 || size > 64) {
+    return NULL;
+  }
+
+  bitboard_t *bitboard = malloc(sizeof(bitboard_t));
+  if (bitboard == NULL) {
+    return NULL;
+  }
+
+  bitboard->size = size;
+  bitboard->size_sqrt = 1;
+  while ((bitboard->size_sqrt + 1) * (bitboard->size_sqrt + 1) <= size) {
+    bitboard->size_sqrt++;
+  }
+  bitboard->full = mask_full(size);
+  bitboard->planes = calloc(size * size, sizeof(uint64_t));
+  bitboard->placed = calloc(size, sizeof(uint64_t));
+
+  if (bitboard->planes == NULL || bitboard->placed == NULL) {
+    bitboard_free(bitboard);
+    return NULL;
+  }
+
+  return bitboard;
+}
+
+void bitboard_free(bitboard_t *bitboard) {
+
+  if (bitboard == NULL) {
+    return;
+  }
+
+  free(bitboard->planes);
+  free(bitboard->placed);
+  free(bitboard);
+}
+
+void bitboard_load(bitboard_t *bitboard, const colors_t *cells) {
+
+  size_t size = bitboard->size;
+
+  memset(bitboard->planes, 0, size * size * sizeof(uint64_t));
+  memset(bitboard->placed, 0, size * sizeof(uint64_t));
+
+  for (size_t row = 0; row < size; row++) {
+    for (size_t column = 0; column < size; column++) {
+      colors_t colors = cells[row * size + column];
+
+      while (colors != 0) {
+        colors_t color = colors_rightmost(colors);
+        bitboard->planes[bit_index(color) * size + row] |= 1UL << column;
+        colors ^= color;
+      }
+    }
+  }
+}
+
+void bitboard_store(const bitboard_t *bitboard, colors_t *cells) {
+
+  size_t size = bitboard->size;
+
+  memset(cells, 0, size * size * sizeof(colors_t));
+
+  for (size_t color_id = 0; color_id < size; color_id++) {
+    for (size_t row = 0; row < size; row++) {
+      uint64_t columns = bitboard->planes[color_id * size + row];
+
+      while (columns != 0) {
+        uint64_t column = mask_rightmost(columns);
+        cells[row * size + bit_index(column)] |= 1UL << color_id;
+        columns ^= column;
+      }
+    }
+  }
+}
+
+/* Set the cell to `color_id` and remove that color from its row, column and
+ * block */
+static void bitboard_place(bitboard_t *bitboard, const size_t color_id,
+                           const size_t row, const size_t column) {
+
+  size_t size = bitboard->size;
+  size_t size_sqrt = bitboard->size_sqrt;
+  uint64_t *plane = &bitboard->planes[color_id * size];
+  uint64_t bit = 1UL << column;
+  uint64_t block = block_columns(bitboard, column);
+  size_t row_start = (row / size_sqrt) * size_sqrt;
+
+  for (size_t other = 0; other < size; other++) {
+    bitboard->planes[other * size + row] &= ~bit;
+  }
+
+  for (size_t other = 0; other < size; other++) {
+    plane[other] &= ~bit;
+  }
+  for (size_t other = row_start; other < row_start + size_sqrt; other++) {
+    plane[other] &= ~block;
+  }
+
+  plane[row] = bit;
+  bitboard->placed[row] |= bit;
+}
+
+/* Propagate the cells left with one color, return False if a cell is
+ * empty */
+static bool bitboard_cross_hatching(bitboard_t *bitboard, bool *changed) {
+
+  size_t size = bitboard->size;
+
+  for (size_t row = 0; row < size; row++) {
+    uint64_t once = 0;
+    uint64_t twice = 0;
+
+    for (size_t color_id = 0; color_id < size; color_id++) {
+      uint64_t columns = bitboard->planes[color_id * size + row];
+      twice |= once & columns;
+      once |= columns;
+    }
+
+    if (once != bitboard->full) {
+      return false;
+    }
+
+    uint64_t singles = once & ~twice & ~bitboard->placed[row];
+
+    while (singles != 0) {
+      uint64_t bit = mask_rightmost(singles);
+      size_t column = bit_index(bit);
+      size_t color_id = 0;
+
+      /* An earlier placement of the row may have emptied the cell */
+      while (color_id < size &&
+             (bitboard->planes[color_id * size + row] & bit) == 0) {
+        color_id++;
+      }
+      if (color_id == size) {
+        return false;
+      }
+
+      bitboard_place(bitboard, color_id, row, column);
+      *changed = true;
+      singles ^= bit;
+    }
+  }
+
+  return true;
+}
+
+/* Place the colors left with one position in a unit, return False if a
+ * color has none */
+static bool bitboard_lone_number(bitboard_t *bitboard, bool *changed) {
+
+  size_t size = bitboard->size;
+  size_t size_sqrt = bitboard->size_sqrt;
+
+  for (size_t color_id = 0; color_id < size; color_id++) {
+    uint64_t *plane = &bitboard->planes[color_id * size];
+
+    /* Rows */
+    for (size_t row = 0; row < size; row++) {
+      if (plane[row] == 0) {
+        return false;
+      }
+      if (mask_is_singleton(plane[row]) &&
+          (plane[row] & bitboard->placed[row]) == 0) {
+        bitboard_place(bitboard, color_id, row, bit_index(plane[row]));
+        *changed = true;
+      }
+    }
+
+    /* Columns */
+    uint64_t once = 0;
+    uint64_t twice = 0;
+    for (size_t row = 0; row < size; row++) {
+      twice |= once & plane[row];
+      once |= plane[row];
+    }
+    if (once != bitboard->full) {
+      return false;
+    }
+
+    uint64_t singles = once & ~twice;
+    for (size_t row = 0; row < size && singles != 0; row++) {
+      uint64_t found = plane[row] & singles;
+      if (found == 0) {
+        continue;
+      }
+      singles &= ~found;
+      found &= ~bitboard->placed[row];
+
+      while (found != 0) {
+        uint64_t bit = mask_rightmost(found);
+        if ((plane[row] & bit) == 0) {
+          return false;
+        }
+        bitboard_place(bitboard, color_id, row, bit_index(bit));
+        *changed = true;
+        found ^= bit;
+      }
+    }
+
+    /* Blocks */
+    for (size_t row_start = 0; row_start < size; row_start += size_sqrt) {
+      for (size_t column = 0; column < size; column += size_sqrt) {
+        uint64_t block = block_columns(bitboard, column);
+        uint64_t columns = 0;
+        size_t nb_rows = 0;
+        size_t single_row = 0;
+
+        for (size_t row = row_start; row < row_start + size_sqrt; row++) {
+          if ((plane[row] & block) != 0) {
+            columns = plane[row] & block;
+            single_row = row;
+            nb_rows++;
+          }
+        }
+
+        if (nb_rows == 0) {
+          return false;
+        }
+        if (nb_rows == 1 && mask_is_singleton(columns) &&
+            (columns & bitboard->placed[single_row]) == 0) {
+          bitboard_place(bitboard, color_id, single_row, bit_index(columns));
+          *changed = true;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+/* Return the columns where the color of `plane` may go in the rows of the
+ * band starting at `row_start` */
+static uint64_t band_columns(const bitboard_t *bitboard, const uint64_t *plane,
+                             const size_t row_start) {
+
+  uint64_t columns = 0;
+
+  for (size_t row = row_start; row < row_start + bitboard->size_sqrt; row++) {
+    columns |= plane[row];
+  }
+
+  return columns;
+}
+
+/* Remove the colors confined to one row or column of a block from the rest
+ * of that row or column (pointing), and the colors of a row or column
+ * confined to one block from the rest of that block (claiming). The columns
+ * of each band are kept in one mask, so that a color is scanned in
+ * O(size) operations. */
+static void bitboard_locked_candidates(bitboard_t *bitboard, bool *changed) {
+
+  size_t size = bitboard->size;
+  size_t size_sqrt = bitboard->size_sqrt;
+  uint64_t bands[size_sqrt];
+
+  for (size_t color_id = 0; color_id < size; color_id++) {
+    uint64_t *plane = &bitboard->planes[color_id * size];
+
+    for (size_t band = 0; band < size_sqrt; band++) {
+      bands[band] = band_columns(bitboard, plane, band * size_sqrt);
+    }
+
+    for (size_t band = 0; band < size_sqrt; band++) {
+      size_t row_start = band * size_sqrt;
+
+      for (size_t column = 0; column < size; column += size_sqrt) {
+        uint64_t block = block_columns(bitboard, column);
+        size_t nb_rows = 0;
+        size_t locked_row = 0;
+
+        for (size_t row = row_start; row < row_start + size_sqrt; row++) {
+          if ((plane[row] & block) != 0) {
+            locked_row = row;
+            nb_rows++;
+          }
+        }
+
+        if (nb_rows == 1 && (plane[locked_row] & ~block) != 0) {
+          plane[locked_row] &= block;
+          bands[band] = band_columns(bitboard, plane, row_start);
+          *changed = true;
+        }
+
+        uint64_t columns = bands[band] & block;
+        if (!mask_is_singleton(columns)) {
+          continue;
+        }
+
+        for (size_t other = 0; other < size_sqrt; other++) {
+          if (other == band || (bands[other] & columns) == 0) {
+            continue;
+          }
+
+          for (size_t row = other * size_sqrt; row < (other + 1) * size_sqrt;
+               row++) {
+            plane[row] &= ~columns;
+          }
+          bands[other] &= ~columns;
+          *changed = true;
+        }
+      }
+    }
+
+    /* Claiming from the rows */
+    for (size_t row = 0; row < size; row++) {
+      if (plane[row] == 0) {
+        continue;
+      }
+
+      uint64_t block =
+          block_columns(bitboard, bit_index(mask_rightmost(plane[row])));
+      if ((plane[row] & ~block) != 0) {
+        continue;
+      }
+
+      size_t row_start = (row / size_sqrt) * size_sqrt;
+      for (size_t other = row_start; other < row_start + size_sqrt; other++) {
+        if (other != row && (plane[other] & block) != 0) {
+          plane[other] &= ~block;
+          *changed = true;
+        }
+      }
+    }
+
+    /* Claiming from the columns: the columns seen in exactly one band */
+    uint64_t once = 0;
+    uint64_t twice = 0;
+    for (size_t band = 0; band < size_sqrt; band++) {
+      bands[band] = band_columns(bitboard, plane, band * size_sqrt);
+      twice |= once & bands[band];
+      once |= bands[band];
+    }
+
+    for (size_t band = 0; band < size_sqrt; band++) {
+      uint64_t confined = bands[band] & ~twice;
+
+      for (size_t column = 0; column < size && confined != 0;
+           column += size_sqrt) {
+        uint64_t block = block_columns(bitboard, column);
+        if ((confined & block) == 0) {
+          continue;
+        }
+
+        /* The first column claims the block, emptying the others if they
+         * were confined too */
+        uint64_t others = block & ~mask_rightmost(confined & block);
+        confined &= ~block;
+
+        for (size_t row = band * size_sqrt; row < (band + 1) * size_sqrt;
+             row++) {
+          if ((plane[row] & others) != 0) {
+            plane[row] &= ~others;
+            *changed = true;
+          }
+        }
+      }
+    }
+  }
+}
+
+size_t bitboard_heuristics(bitboard_t *bitboard, bool use_locked_candidates) {
+
+  bool changed = true;
+
+  while (changed) {
+    changed = false;
+
+    if (!bitboard_cross_hatching(bitboard, &changed) ||
+        !bitboard_lone_number(bitboard, &changed)) {
+      return status_code_grid_is_inconsistent;
+    }
+
+    if (use_locked_candidates && !changed) {
+      bitboard_locked_candidates(bitboard, &changed);
+    }
+  }
+
+  for (size_t row = 0; row < bitboard->size; row++) {
+    if (bitboard->placed[row] != bitboard->full) {
+      return status_code_grid_is_not_solved_and_consistent;
+    }
+  }
+
+  return status_code_grid_is_solved;
+}
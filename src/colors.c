@@ -4,22 +4,17 @@
 
 #include "grid.h"
 #include <math.h>
-#include <time.h>
-
-#define ULONG_MAX 0xffffffffffffffff
-
-static bool seed_intialized = false;
 
 colors_t colors_full(const size_t size) {
 
-  return (size >= MAX_COLORS) ? ULONG_MAX : (1UL << size) - 1;
+  return (size >= MAX_COLORS) ? ~(colors_t)0 : ((colors_t)1 << size) - 1;
 }
 
 colors_t colors_empty(void) { return 0; }
 
 colors_t colors_set(const size_t color_id) {
 
-  return color_id >= MAX_COLORS ? 0 : 1UL << color_id;
+  return color_id >= MAX_COLORS ? 0 : (colors_t)1 << color_id;
 }
 
 colors_t colors_add(const colors_t colors, const size_t color_id) {
@@ -47,7 +42,7 @@ bool colors_is_in(const colors_t colors, const size_t color_id) {
 
 colors_t colors_negate(const colors_t colors) {
 
-  return colors_xor(colors, ULONG_MAX);
+  return colors_xor(colors, ~(colors_t)0);
 }
 
 colors_t colors_and(const colors_t colors1, const colors_t colors2) {
@@ -75,24 +70,32 @@ bool colors_is_singleton(const colors_t colors) {
   return colors == 0 ? false : (colors & (colors - 1)) == 0;
 }
 
-size_t colors_count(const colors_t colors) {
+/* Return the number of bits set in a word */
+static size_t word_count(const uint64_t word) {
 
-  colors_t colors_count = colors;
+  uint64_t count = word;
 
   /* In binary, 0x5555555555555555 looks like ..0101 */
-  colors_count = colors_count - ((colors_count >> 1) & 0x5555555555555555);
+  count = count - ((count >> 1) & 0x5555555555555555);
 
   /* 0x3333333333333333 looks like ..0011 */
-  colors_count = (colors_count & 0x3333333333333333) +
-                 ((colors_count >> 2) & 0x3333333333333333);
+  count = (count & 0x3333333333333333) + ((count >> 2) & 0x3333333333333333);
 
   /* 0x0F0F0F0F0F0F0F0F looks like ..00001111 */
   /* 0x0101010101010101 looks like ..000000001 */
-  colors_count = (((colors_count + (colors_count >> 4)) & 0x0F0F0F0F0F0F0F0F) *
-                  0x0101010101010101) >>
-                 56;
+  count = (((count + (count >> 4)) & 0x0F0F0F0F0F0F0F0F) * 0x0101010101010101) >>
+          56;
+
+  return count;
+}
+
+size_t colors_count(const colors_t colors) {
 
-  return colors_count;
+#ifdef COLORS_WIDE
+  return word_count((uint64_t)colors) + word_count((uint64_t)(colors >> 64));
+#else
+  return word_count(colors);
+#endif
 }
 
 bool colors_is_subset(const colors_t colors1, const colors_t colors2) {
@@ -131,7 +134,7 @@ colors_t colors_leftmost(const colors_t colors) {
   return colors_set(pos - 1);
 }
 
-colors_t colors_random(colors_t colors) {
+colors_t colors_random(colors_t colors, prng_t *prng) {
 
   if (colors == 0) {
     return colors_empty();
@@ -139,12 +142,7 @@ colors_t colors_random(colors_t colors) {
 
   size_t nb_colors = colors_count(colors);
 
-  if (!seed_intialized) {
-    srand(time(NULL));
-    seed_intialized = true;
-  }
-
-  size_t random_color = (rand() % nb_colors) + 1;
+  size_t random_color = prng_bounded(prng, nb_colors) + 1;
 
   size_t pos = 0;
   while (random_color != 0) {
@@ -204,6 +202,7 @@ bool lone_number(colors_t *subgrid[], size_t size) {
   bool subgrid_changed = false;
   colors_t all_colors = colors_empty();
   colors_t common_colors = colors_empty();
+  colors_t singleton_colors = colors_empty();
 
   for (size_t i = 0; i < size; i++) {
 
@@ -212,10 +211,15 @@ bool lone_number(colors_t *subgrid[], size_t size) {
       colors_t intersection = colors_and(all_colors, *subgrid[i]);
       all_colors = colors_or(all_colors, *subgrid[i]);
       common_colors = colors_or(common_colors, intersection);
+    } else {
+      singleton_colors = colors_or(singleton_colors, *subgrid[i]);
     }
   }
 
+  /* A color already placed in the subgrid is not a lone number, even if
+   * cross-hatching has not yet removed it from the other cells */
   all_colors = colors_subtract(all_colors, common_colors);
+  all_colors = colors_subtract(all_colors, singleton_colors);
 
   if (all_colors != 0) {
 
@@ -233,106 +237,317 @@ bool lone_number(colors_t *subgrid[], size_t size) {
   return subgrid_changed;
 }
 
-/** Return
- *  + True if 'naked_subset' heuristic could be applied on subgrid
- *  + False otherwise
- */
-static bool naked_subset(colors_t *subgrid[], size_t size) {
+/* Subsets combinations explored for one subgrid. For naked subsets, the sets
+ * are the candidates of the unsolved cells, for hidden subsets they are the
+ * positions of the colors not placed yet. */
+typedef struct {
+  colors_t **subgrid;
+  size_t size;
+  bool is_hidden;
+  colors_t sets[MAX_COLORS];
+  size_t items[MAX_COLORS]; /* Cell (naked) or color (hidden) of each set */
+  size_t nb_sets;
+  size_t order;
+  bool changed;
+} subsets_t;
+
+static size_t subset_max_order = DEFAULT_SUBSET_ORDER;
+
+void subset_set_max_order(const size_t order) { subset_max_order = order; }
+
+/* Remove the colors implied by the subset made of the chosen sets, whose
+ * union is `set_union` */
+static void subset_apply(subsets_t *subsets, const colors_t chosen,
+                         const colors_t set_union) {
+
+  colors_t **subgrid = subsets->subgrid;
+
+  if (!subsets->is_hidden) {
+    /* The colors of the naked subset are removed from all the other cells */
+    colors_t cells = 0;
+    for (size_t i = 0; i < subsets->nb_sets; i++) {
+      if (colors_is_in(chosen, i)) {
+        cells = colors_add(cells, subsets->items[i]);
+      }
+    }
 
-  bool subgrid_changed = false;
+    for (size_t cell = 0; cell < subsets->size; cell++) {
+      if (!colors_is_in(cells, cell) && !colors_is_singleton(*subgrid[cell]) &&
+          colors_and(*subgrid[cell], set_union) != 0) {
+        *subgrid[cell] = colors_subtract(*subgrid[cell], set_union);
+        subsets->changed = true;
+      }
+    }
+  } else {
+    /* The cells of the hidden subset only keep the colors of the subset */
+    colors_t colors = 0;
+    for (size_t i = 0; i < subsets->nb_sets; i++) {
+      if (colors_is_in(chosen, i)) {
+        colors = colors_add(colors, subsets->items[i]);
+      }
+    }
 
-  for (size_t i = 0; i < size; i++) {
+    for (size_t cell = 0; cell < subsets->size; cell++) {
+      if (colors_is_in(set_union, cell) &&
+          colors_subtract(*subgrid[cell], colors) != 0) {
+        *subgrid[cell] = colors_and(*subgrid[cell], colors);
+        subsets->changed = true;
+      }
+    }
+  }
+}
 
-    if (!colors_is_singleton(*subgrid[i])) {
+/* Extend the chosen sets with sets taken from `first` on, as long as their
+ * union does not exceed the order of the subsets */
+static void subset_search(subsets_t *subsets, const size_t first,
+                          const size_t depth, const colors_t chosen,
+                          const colors_t set_union) {
 
-      colors_t *not_naked_candidates[size];
-      size_t index = 0;
-      size_t counter = 0; /* count the number of naked candidates */
+  if (depth == subsets->order) {
+    if (colors_count(set_union) == subsets->order) {
+      subset_apply(subsets, chosen, set_union);
+    }
+    return;
+  }
 
-      for (size_t j = 0; j < size; j++) {
+  /* Not enough sets left to complete the subset */
+  size_t nb_missing = subsets->order - depth;
 
-        if (!colors_is_singleton(*subgrid[j])) {
-          if (colors_is_subset(*subgrid[j], *subgrid[i])) {
-            counter++;
-          } else {
-            not_naked_candidates[index] = subgrid[j];
-            index++;
-          }
-        }
-      }
+  for (size_t i = first; i + nb_missing <= subsets->nb_sets; i++) {
+    colors_t new_union = colors_or(set_union, subsets->sets[i]);
 
-      if (counter == colors_count(*subgrid[i])) {
+    if (colors_count(new_union) <= subsets->order) {
+      subset_search(subsets, i + 1, depth + 1, colors_add(chosen, i),
+                    new_union);
+    }
+  }
+}
 
-        for (size_t j = 0; j < index; j++) {
+/* Look for subsets of order 2 up to `subset_max_order`, smallest first. Only
+ * sets with 2 to `order` elements can be part of a subset of that order. */
+static bool subsets_search(subsets_t *subsets, const colors_t *sets,
+                           const size_t nb_items, const size_t nb_unsolved) {
 
-          colors_t colors_removed =
-              colors_discard_B_from_A(*not_naked_candidates[j], *subgrid[i]);
+  /* A subset of order k comes with a complementary one of order
+   * `nb_unsolved - k` of the other kind, only the smallest is looked for */
+  size_t max_order = subset_max_order < nb_unsolved / 2 ? subset_max_order
+                                                        : nb_unsolved / 2;
 
-          if (!colors_is_equal(colors_removed, *not_naked_candidates[j])) {
-            subgrid_changed = true;
-            *not_naked_candidates[j] = colors_removed;
-          }
-        }
+  subsets->changed = false;
+
+  for (size_t order = 2; order <= max_order; order++) {
+    subsets->order = order;
+    subsets->nb_sets = 0;
+
+    for (size_t item = 0; item < nb_items; item++) {
+      size_t count = colors_count(sets[item]);
+
+      if (count >= 2 && count <= order) {
+        subsets->sets[subsets->nb_sets] = sets[item];
+        subsets->items[subsets->nb_sets] = item;
+        subsets->nb_sets++;
       }
     }
+
+    if (subsets->nb_sets >= order) {
+      subset_search(subsets, 0, 0, colors_empty(), colors_empty());
+    }
   }
 
-  return subgrid_changed;
+  return subsets->changed;
+}
+
+/** Return
+ *  + True if 'naked_subset' heuristic could be applied on subgrid
+ *  + False otherwise
+ */
+bool naked_subset(colors_t *subgrid[], size_t size) {
+
+  subsets_t subsets = {.subgrid = subgrid, .size = size, .is_hidden = false};
+  colors_t candidates[MAX_COLORS];
+  size_t nb_unsolved = 0;
+
+  for (size_t i = 0; i < size; i++) {
+    candidates[i] = colors_is_singleton(*subgrid[i]) ? 0 : *subgrid[i];
+    nb_unsolved += (candidates[i] != 0);
+  }
+
+  return nb_unsolved >= 4 &&
+         subsets_search(&subsets, candidates, size, nb_unsolved);
 }
 
 /** Return
  *  + True if 'hidden_subset' heuristic could be applied on subgrid
  *  + False otherwise
  */
-static bool hidden_subset(colors_t *subgrid[], size_t size) {
+bool hidden_subset(colors_t *subgrid[], size_t size) {
 
-  bool subgrid_changed = false;
+  subsets_t subsets = {.subgrid = subgrid, .size = size, .is_hidden = true};
+  colors_t positions[MAX_COLORS] = {0};
+  colors_t placed_colors = 0;
+  size_t nb_unsolved = 0;
 
   for (size_t i = 0; i < size; i++) {
+    if (colors_is_singleton(*subgrid[i])) {
+      placed_colors = colors_or(placed_colors, *subgrid[i]);
+    } else {
+      nb_unsolved++;
+    }
+  }
 
-    if (!colors_is_singleton(*subgrid[i])) {
+  if (nb_unsolved < 4) {
+    return false;
+  }
 
-      colors_t reference_colors = *subgrid[i];
+  /* Positions of each color among the unsolved cells */
+  for (size_t i = 0; i < size; i++) {
+    if (colors_is_singleton(*subgrid[i])) {
+      continue;
+    }
 
-      size_t tab_index[size]; /** Contains the index of hidden candidates */
-      size_t nb_element_tab = 0;
+    colors_t colors = colors_subtract(*subgrid[i], placed_colors);
+    while (colors != 0) {
+      colors_t color = colors_rightmost(colors);
+      size_t color_id = colors_count(color - 1);
+      positions[color_id] = colors_add(positions[color_id], i);
+      colors = colors_subtract(colors, color);
+    }
+  }
 
-      for (size_t j = 0; j < size; j++) {
+  return subsets_search(&subsets, positions, size, nb_unsolved);
+}
 
-        if (colors_and(reference_colors, *subgrid[j]) > 0) {
-          tab_index[nb_element_tab] = j;
-          nb_element_tab++;
-        }
-      }
+/* Perfect matchings between the cells of a subgrid and the colors */
+typedef struct {
+  colors_t **subgrid;
+  uint8_t cell_of[MAX_COLORS];  /* Cell matched with each color */
+  uint8_t color_of[MAX_COLORS]; /* Color matched with each cell */
+  colors_t matched_colors;
+} matching_t;
+
+/* Look for an augmenting path from `cell` through the colors not `visited`
+ * yet, and flip it. Return True if `cell` could be matched. */
+static bool matching_augment(matching_t *matching, const size_t cell,
+                             colors_t *visited) {
+
+  colors_t candidates = colors_subtract(*matching->subgrid[cell], *visited);
+
+  /* Free colors first: most cells are matched without any path */
+  colors_t free_colors =
+      colors_subtract(candidates, matching->matched_colors);
+  if (free_colors != 0) {
+    candidates = free_colors;
+  }
 
-      if (nb_element_tab == colors_count(reference_colors)) {
+  while (candidates != 0) {
+    colors_t color = colors_rightmost(candidates);
+    size_t color_id = colors_count(color - 1);
+    candidates = colors_subtract(candidates, color);
+    *visited = colors_or(*visited, color);
+
+    if (!colors_is_in(matching->matched_colors, color_id) ||
+        matching_augment(matching, matching->cell_of[color_id], visited)) {
+      matching->cell_of[color_id] = cell;
+      matching->color_of[cell] = color_id;
+      matching->matched_colors = colors_or(matching->matched_colors, color);
+      return true;
+    }
+  }
+
+  return false;
+}
 
-        for (size_t k = 0; k < nb_element_tab; k++) {
+/* Match every cell of the subgrid with a different color, return False if
+ * there is no such matching */
+static bool matching_find(matching_t *matching, const size_t size) {
 
-          colors_t candidates_cell_colors = *subgrid[tab_index[k]];
+  matching->matched_colors = 0;
 
-          colors_t candidates_cell_new_colors =
-              colors_and(reference_colors, candidates_cell_colors);
+  for (size_t cell = 0; cell < size; cell++) {
+    colors_t visited = 0;
 
-          if (candidates_cell_colors != candidates_cell_new_colors) {
-            *subgrid[tab_index[k]] = candidates_cell_new_colors;
-            subgrid_changed = true;
-          }
-        }
-      }
+    if (!matching_augment(matching, cell, &visited)) {
+      return false;
     }
   }
 
-  return subgrid_changed;
+  return true;
+}
+
+static bool all_different_enabled = false;
+
+void all_different_set_enabled(const bool enabled) {
+
+  all_different_enabled = enabled;
+}
+
+bool all_different_is_enabled(void) { return all_different_enabled; }
+
+bool all_different_check(colors_t *subgrid[], size_t size) {
+
+  matching_t matching = {.subgrid = subgrid};
+
+  return matching_find(&matching, size);
 }
 
-bool subgrid_heuristics(colors_t *subgrid[], size_t size) {
+/** Régin's filtering: the matching is perfect, so a color of a cell is
+ *  part of some perfect matching if and only if the cell matched with that
+ *  color can reach back the cell by following "cell -> cell matched with one
+ *  of its colors" edges. Return
+ *  + True if colors were removed (a cell is emptied if there is no perfect
+ *    matching at all)
+ *  + False otherwise
+ */
+bool all_different(colors_t *subgrid[], size_t size) {
+
+  matching_t matching = {.subgrid = subgrid};
+
+  if (!matching_find(&matching, size)) {
+    /* Left to the consistency check of the subgrid */
+    for (size_t cell = 0; cell < size; cell++) {
+      *subgrid[cell] = colors_empty();
+    }
+    return true;
+  }
+
+  /* Transitive closure of the cells graph, one bitmask per cell */
+  colors_t reach[MAX_COLORS];
+
+  for (size_t cell = 0; cell < size; cell++) {
+    reach[cell] = 0;
+
+    colors_t colors = *subgrid[cell];
+    while (colors != 0) {
+      colors_t color = colors_rightmost(colors);
+      reach[cell] = colors_add(reach[cell],
+                               matching.cell_of[colors_count(color - 1)]);
+      colors = colors_subtract(colors, color);
+    }
+  }
+
+  for (size_t k = 0; k < size; k++) {
+    for (size_t cell = 0; cell < size; cell++) {
+      if (colors_is_in(reach[cell], k)) {
+        reach[cell] = colors_or(reach[cell], reach[k]);
+      }
+    }
+  }
 
   bool subgrid_changed = false;
-  subgrid_changed |= cross_hatching(subgrid, size);
-  subgrid_changed |= lone_number(subgrid, size);
-  if (subgrid_changed) {
-    subgrid_changed |= naked_subset(subgrid, size);
+
+  for (size_t cell = 0; cell < size; cell++) {
+    colors_t colors = colors_discard(*subgrid[cell], matching.color_of[cell]);
+
+    while (colors != 0) {
+      colors_t color = colors_rightmost(colors);
+      size_t other = matching.cell_of[colors_count(color - 1)];
+      colors = colors_subtract(colors, color);
+
+      if (!colors_is_in(reach[other], cell)) {
+        *subgrid[cell] = colors_subtract(*subgrid[cell], color);
+        subgrid_changed = true;
+      }
+    }
   }
 
   return subgrid_changed;
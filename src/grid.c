@@ -3,19 +3,30 @@
 #include <colors.h>
 
 #include <math.h>
+#include <stdatomic.h>
 #include <string.h>
+#include <threads.h>
 #include <time.h>
 
 #define status_code_grid_is_not_solved_and_consistent 0
 #define status_code_grid_is_solved 1
 #define status_code_grid_is_inconsistent 2
 
-static bool seed_intialized = false;
+/* Cells written since the start of a probe, each one recorded once with
+ * the colors it had, so that the probe is undone in place */
+typedef struct {
+  uint64_t *recorded; /* Bitset of the cells in the trail */
+  uint16_t *cells;
+  colors_t *colors;
+  size_t nb_cells;
+} trail_t;
 
 /* Internal structure (hiden from outside) to represent a sudoku grid */
 struct _grid_t {
   size_t size;
   colors_t **cells;
+  grid_hash_t hash; /* Of the colors removed from the cells */
+  trail_t *trail;   /* Records the writes when not NULL */
 };
 
 struct choice_t {
@@ -24,6 +35,15 @@ struct choice_t {
   colors_t color;
 };
 
+struct removal_t {
+  size_t size;
+  size_t nb_cells;
+  size_t next;        /* Position in `order` of the next cell to try */
+  uint32_t *order;    /* Cells (row * size + column) shuffled once */
+  uint64_t *excluded; /* Bitset of the cells whose color must be kept */
+  uint64_t *removed;  /* Bitset of the cells whose color has been removed */
+};
+
 void grid_print(const grid_t *grid, FILE *fd) {
   size_t grid_size = grid_get_size(grid);
 
@@ -36,7 +56,7 @@ void grid_print(const grid_t *grid, FILE *fd) {
         return;
       }
 
-      if (strlen(colors) == grid_size) {
+      if (colors_count(grid->cells[i][j]) == grid_size) {
 
         fprintf(fd, "%c", (grid_size == 1) ? color_table[0] : EMPTY_CELL);
 
@@ -94,7 +114,9 @@ bool grid_check_char(const grid_t *grid, const char c) {
   return res;
 }
 
-grid_t *grid_alloc(size_t size) {
+/* Allocate a grid of size*size cells, whose colors and hash are left to
+ * the caller */
+static grid_t *grid_new(size_t size) {
 
   if (!grid_check_size(size)) {
     return NULL;
@@ -106,38 +128,71 @@ grid_t *grid_alloc(size_t size) {
   }
 
   grid->size = size;
+  grid->trail = NULL;
   grid->cells = malloc(size * sizeof(colors_t *));
   if (grid->cells == NULL) {
     return NULL;
   }
 
-  for (size_t i = 0; i < size; i++) {
+  /* All the cells live in one block so that a grid is copied at once */
+  grid->cells[0] = malloc(size * size * sizeof(colors_t));
+  if (grid->cells[0] == NULL) {
+    return NULL;
+  }
 
-    grid->cells[i] = malloc(size * sizeof(colors_t));
-    if (grid->cells[i] == NULL) {
-      return NULL;
-    }
+  for (size_t i = 1; i < size; i++) {
+    grid->cells[i] = grid->cells[0] + i * size;
   }
 
   return grid;
 }
 
-void grid_free(grid_t *grid) {
+/* Hash of the grids of `size` whose cells have every color, apart from
+ * the words of the literals of hash_toggle() */
+static grid_hash_t hash_empty(const size_t size) {
+
+  uint64_t z = size * 0xD1B54A32D192ED03;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+
+  return (grid_hash_t){.key = z ^ (z >> 31), .check = z};
+}
+
+grid_t *grid_alloc(size_t size) {
 
+  grid_t *grid = grid_new(size);
   if (grid == NULL) {
-    return;
+    return NULL;
+  }
+
+  colors_t full = colors_full(size);
+  for (size_t cell = 0; cell < size * size; cell++) {
+    grid->cells[0][cell] = full;
   }
+  grid->hash = hash_empty(size);
+
+  return grid;
+}
+
+void grid_free(grid_t *grid) {
 
-  for (size_t i = 0; i < grid_get_size(grid); i++) {
-    free(grid->cells[i]);
+  if (grid == NULL) {
+    return;
   }
 
+  free(grid->cells[0]);
   free(grid->cells);
   free(grid);
 }
 
 bool grid_check_size(const size_t size) {
 
+#ifdef COLORS_WIDE
+  if ((size == 81) || (size == 100)) {
+    return true;
+  }
+#endif
+
   return (size == 1) || (size == 4) || (size == 9) || (size == 16) ||
          (size == 25) || (size == 36) || (size == 49) || (size == 64);
 }
@@ -150,15 +205,13 @@ grid_t *grid_copy(const grid_t *grid) {
 
   grid_t *grid_copy;
 
-  grid_copy = grid_alloc(grid->size);
+  grid_copy = grid_new(grid->size);
   if (grid_copy == NULL)
     return NULL;
 
-  for (size_t i = 0; i < grid->size; i++) {
-    for (size_t j = 0; j < grid->size; j++) {
-      grid_copy->cells[i][j] = grid->cells[i][j];
-    }
-  }
+  memcpy(grid_copy->cells[0], grid->cells[0],
+         grid->size * grid->size * sizeof(colors_t));
+  grid_copy->hash = grid->hash;
 
   return grid_copy;
 }
@@ -169,10 +222,139 @@ void grid_deep_copy(grid_t *grid_a, grid_t *grid_b) {
     return;
   }
 
-  for (size_t i = 0; i < size; i++) {
-    for (size_t j = 0; j < size; j++) {
-      grid_a->cells[i][j] = grid_b->cells[i][j];
+  memcpy(grid_a->cells[0], grid_b->cells[0], size * size * sizeof(colors_t));
+  grid_a->hash = grid_b->hash;
+}
+
+/* Xor in the hash of `grid` the random words of the color `color_id` of
+ * `cell`: the splitmix64 output of the literal for the key, mixed once more
+ * for the check, so that every (cell, color) has words of its own */
+static void hash_toggle(grid_t *grid, const size_t cell,
+                        const size_t color_id) {
+
+  uint64_t z = (cell * grid->size + color_id + 1) * 0x9E3779B97F4A7C15;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+  z ^= z >> 31;
+  grid->hash.key ^= z;
+
+  z = (z ^ (z >> 32)) * 0xD6E8FEB86659FD93;
+  grid->hash.check ^= z ^ (z >> 32);
+}
+
+/* Update the hash of `grid` for `cell` going from `old_colors` to
+ * `new_colors`, each color added or removed toggles its words */
+static void hash_update(grid_t *grid, const size_t cell,
+                        const colors_t old_colors, const colors_t new_colors) {
+
+  colors_t changed = old_colors ^ new_colors;
+
+  while (changed != 0) {
+    colors_t color = colors_rightmost(changed);
+    hash_toggle(grid, cell, colors_count(color - 1));
+    changed ^= color;
+  }
+}
+
+/* Record the colors of `cell` before its first write of the probe */
+static void trail_record(trail_t *trail, const size_t cell,
+                         const colors_t colors) {
+
+  if ((trail->recorded[cell / 64] & ((uint64_t)1 << cell % 64)) == 0) {
+    trail->recorded[cell / 64] |= (uint64_t)1 << cell % 64;
+    trail->cells[trail->nb_cells] = cell;
+    trail->colors[trail->nb_cells++] = colors;
+  }
+}
+
+/* Set the colors of `cell`, row * size + column, keeping the hash up to
+ * date */
+static void cell_write(grid_t *grid, const size_t cell, const colors_t colors) {
+
+  if (grid->trail != NULL) {
+    trail_record(grid->trail, cell, grid->cells[0][cell]);
+  }
+  hash_update(grid, cell, grid->cells[0][cell], colors);
+  grid->cells[0][cell] = colors;
+}
+
+grid_hash_t grid_hash(const grid_t *grid) { return grid->hash; }
+
+void grid_get_colors(const grid_t *grid, colors_t *cells) {
+
+  memcpy(cells, grid->cells[0], grid->size * grid->size * sizeof(colors_t));
+}
+
+void grid_set_colors(grid_t *grid, const colors_t *cells) {
+
+  for (size_t cell = 0; cell < grid->size * grid->size; cell++) {
+    if (grid->cells[0][cell] != cells[cell]) {
+      cell_write(grid, cell, cells[cell]);
+    }
+  }
+}
+
+size_t grid_cell_bytes(const size_t size) {
+
+  return size <= 16 ? sizeof(uint16_t)
+                    : size <= 32 ? sizeof(uint32_t) : sizeof(colors_t);
+}
+
+void grid_pack(const grid_t *grid, void *buffer) {
+
+  size_t nb_cells = grid->size * grid->size;
+  const colors_t *cells = grid->cells[0];
+
+  switch (grid_cell_bytes(grid->size)) {
+  case sizeof(uint16_t): {
+    uint16_t *packed = buffer;
+    for (size_t cell = 0; cell < nb_cells; cell++) {
+      packed[cell] = (uint16_t)cells[cell];
+    }
+    break;
+  }
+
+  case sizeof(uint32_t): {
+    uint32_t *packed = buffer;
+    for (size_t cell = 0; cell < nb_cells; cell++) {
+      packed[cell] = (uint32_t)cells[cell];
+    }
+    break;
+  }
+
+  default:
+    memcpy(buffer, cells, nb_cells * sizeof(colors_t));
+  }
+}
+
+void grid_unpack(grid_t *grid, const void *buffer) {
+
+  size_t nb_cells = grid->size * grid->size;
+  const colors_t *cells = grid->cells[0];
+
+  switch (grid_cell_bytes(grid->size)) {
+  case sizeof(uint16_t): {
+    const uint16_t *packed = buffer;
+    for (size_t cell = 0; cell < nb_cells; cell++) {
+      if (cells[cell] != packed[cell]) {
+        cell_write(grid, cell, packed[cell]);
+      }
+    }
+    break;
+  }
+
+  case sizeof(uint32_t): {
+    const uint32_t *packed = buffer;
+    for (size_t cell = 0; cell < nb_cells; cell++) {
+      if (cells[cell] != packed[cell]) {
+        cell_write(grid, cell, packed[cell]);
+      }
     }
+    break;
+  }
+
+  default:
+    grid_set_colors(grid, buffer);
   }
 }
 
@@ -190,7 +372,7 @@ static colors_t char2color(const char color, size_t grid_size) {
 
   size_t i;
 
-  for (i = 0; i < MAX_GRID_SIZE; i++) {
+  for (i = 0; i < sizeof(color_table) - 1; i++) {
     if (color_table[i] == color) {
       break;
     }
@@ -204,6 +386,25 @@ static char *colors2string(const colors_t colors, size_t grid_size) {
 
   size_t nb_colors = colors_count(colors);
 
+  if (grid_size > MAX_CHAR_GRID_SIZE) {
+    /* Numbers of at most 3 digits, separated by commas */
+    char *colors_string = malloc(sizeof(char) * (4 * nb_colors + 1));
+    if (colors_string == NULL) {
+      return NULL;
+    }
+
+    size_t length = 0;
+    colors_string[0] = '\0';
+    for (size_t i = 0; i < grid_size; i++) {
+      if (colors_is_in(colors, i)) {
+        length += sprintf(colors_string + length, "%s%zu",
+                          length == 0 ? "" : ",", i + 1);
+      }
+    }
+
+    return colors_string;
+  }
+
   char *colors_string = malloc(sizeof(char) * (nb_colors + 1));
   if (colors_string == NULL) {
     return NULL;
@@ -221,14 +422,14 @@ static char *colors2string(const colors_t colors, size_t grid_size) {
   return colors_string;
 }
 
-void grid_set_cell(const grid_t *grid, const size_t row, const size_t column,
+void grid_set_cell(grid_t *grid, const size_t row, const size_t column,
                    const char color) {
 
   if ((grid == NULL) || (row >= grid->size) || (column >= grid->size)) {
     return;
   }
 
-  grid->cells[row][column] = char2color(color, grid->size);
+  cell_write(grid, row * grid->size + column, char2color(color, grid->size));
 }
 
 char *grid_get_cell(const grid_t *grid, const size_t row, const size_t column) {
@@ -244,6 +445,12 @@ char *grid_get_cell(const grid_t *grid, const size_t row, const size_t column) {
 static size_t get_sqrt(const size_t size) {
 
   switch (size) {
+  case 100:
+    return 10;
+
+  case 81:
+    return 9;
+
   case 64:
     return 8;
 
@@ -273,6 +480,51 @@ static size_t get_sqrt(const size_t size) {
   }
 }
 
+static bool bitset_is_in(const uint64_t *bitset, const size_t index) {
+
+  return (bitset[index / 64] >> (index % 64)) & 1;
+}
+
+static void bitset_add(uint64_t *bitset, const size_t index) {
+
+  bitset[index / 64] |= (uint64_t)1 << (index % 64);
+}
+
+static void bitset_discard(uint64_t *bitset, const size_t index) {
+
+  bitset[index / 64] &= ~((uint64_t)1 << (index % 64));
+}
+
+/* Fill `subgrid` with the cells of the `unit`-th unit of `grid`, numbered
+ * rows first, then columns, then blocks */
+static void grid_unit(grid_t *grid, const size_t unit, colors_t *subgrid[]) {
+
+  size_t size = grid->size;
+  size_t index = 0;
+
+  if (unit < size) {
+    for (size_t column = 0; column < size; column++) {
+      subgrid[index++] = &grid->cells[unit][column];
+    }
+  } else if (unit < 2 * size) {
+    for (size_t row = 0; row < size; row++) {
+      subgrid[index++] = &grid->cells[row][unit - size];
+    }
+  } else {
+    size_t size_sqrt = get_sqrt(size);
+    size_t block = unit - 2 * size;
+    size_t row_start = ((block / size_sqrt) * size_sqrt);
+    size_t column_start = ((block % size_sqrt) * size_sqrt);
+
+    for (size_t row = row_start; row < size_sqrt + row_start; row++) {
+      for (size_t column = column_start; column < size_sqrt + column_start;
+           column++) {
+        subgrid[index++] = &grid->cells[row][column];
+      }
+    }
+  }
+}
+
 /* Return True if the subgrid is consistent, False otherwise */
 static bool subgrid_consistency(colors_t *subgrid[], const size_t size) {
 
@@ -303,7 +555,12 @@ static bool subgrid_consistency(colors_t *subgrid[], const size_t size) {
     subgrid_colors = colors_or(subgrid_colors, *subgrid[i]);
   }
 
-  return subgrid_colors == colors_full(size);
+  if (subgrid_colors != colors_full(size)) {
+    return false;
+  }
+
+  /* The matching also finds the cells sharing too few colors */
+  return !all_different_is_enabled() || all_different_check(subgrid, size);
 }
 
 bool grid_is_consistent(grid_t *grid) {
@@ -361,252 +618,1606 @@ bool grid_is_consistent(grid_t *grid) {
   return true;
 }
 
-static bool grid_is_solved(grid_t *grid) {
+/* Words of a bitset over the units of a grid, numbered as in grid_unit() */
+#define UNITS_WORDS ((3 * MAX_GRID_SIZE + 63) / 64)
 
-  for (size_t i = 0; i < grid->size; i++) {
+/* Mark the row, column and block of a cell in the bitset of units `dirty` */
+static void units_mark_cell(uint64_t *dirty, const size_t size,
+                            const size_t row, const size_t column) {
 
-    for (size_t j = 0; j < grid->size; j++) {
+  size_t size_sqrt = get_sqrt(size);
 
-      if (!colors_is_singleton(grid->cells[i][j])) {
-        return false;
+  bitset_add(dirty, row);
+  bitset_add(dirty, size + column);
+  bitset_add(dirty, 2 * size + (row / size_sqrt) * size_sqrt +
+                        column / size_sqrt);
+}
+
+/* Check the units marked in `dirty`, the only ones which lost colors since
+ * the last check, with the matching of --all-different and clear them.
+ * Return False on a contradiction. */
+static bool units_matching(grid_t *grid, uint64_t *dirty) {
+
+  colors_t *subgrid[grid->size];
+  bool is_consistent = true;
+
+  for (size_t word = 0; word < UNITS_WORDS; word++) {
+    while (dirty[word] != 0) {
+      size_t unit = word * 64 + colors_count(colors_rightmost(dirty[word]) - 1);
+
+      dirty[word] &= dirty[word] - 1;
+      if (is_consistent && all_different_is_enabled()) {
+        grid_unit(grid, unit, subgrid);
+        is_consistent = all_different_check(subgrid, grid->size);
       }
     }
   }
 
-  return true;
+  return is_consistent;
 }
 
-/* Remove specified colors from specified row. Colors between specified columns
- * will not be removed */
-static bool remove_colors_from_row(grid_t *grid, colors_t colors_to_remove,
-                                   size_t row, size_t column_excluded_start,
-                                   size_t column_excluded_end) {
-
-  bool changed = false;
+/* Return False if a cell of `grid` is empty or a unit has no cell left for
+ * one of the colors. The writes made outside of the heuristics, by the
+ * choices and the probes, are only checked here. */
+static bool units_cover(const grid_t *grid) {
 
-  for (size_t column = 0; column < grid->size; column++) {
+  size_t size = grid->size;
+  size_t size_sqrt = get_sqrt(size);
+  colors_t full = colors_full(size);
+  colors_t columns[size];
+  colors_t blocks[size];
 
-    if (column < column_excluded_start || column > column_excluded_end) {
+  memset(columns, 0, sizeof(columns));
+  memset(blocks, 0, sizeof(blocks));
+  for (size_t row = 0; row < size; row++) {
+    colors_t row_colors = 0;
 
-      colors_t *cell_colors = &grid->cells[row][column];
-      colors_t colors_removed_from_cell =
-          colors_discard_B_from_A(*cell_colors, colors_to_remove);
+    for (size_t column = 0; column < size; column++) {
+      colors_t colors = grid->cells[row][column];
+      size_t block = (row / size_sqrt) * size_sqrt + column / size_sqrt;
 
-      if (!colors_is_singleton(*cell_colors) &&
-          colors_removed_from_cell != *cell_colors) {
-        changed = true;
-        *cell_colors = colors_removed_from_cell;
+      if (colors == 0) {
+        return false;
       }
+      row_colors |= colors;
+      columns[column] |= colors;
+      blocks[block] |= colors;
+    }
+
+    if (row_colors != full) {
+      return false;
     }
   }
-  return changed;
+
+  for (size_t i = 0; i < size; i++) {
+    if (columns[i] != full || blocks[i] != full) {
+      return false;
+    }
+  }
+
+  return true;
 }
 
-/* Remove specified colors from specified column. Colors in specified rows
- * will not be removed */
-static bool remove_colors_from_column(grid_t *grid, colors_t colors_to_remove,
-                                      size_t column, size_t row_excluded_start,
-                                      size_t row_excluded_end) {
+#define UNIT_COUNT_UNKNOWN UINT8_MAX
 
-  bool changed = false;
+/* Cells holding each color in each unit, kept along the eliminations of a
+ * run of the heuristics so that a contradiction is found where it appears.
+ * A color of a unit is counted the first time it is removed. */
+typedef struct {
+  grid_t *grid;
+  size_t size_sqrt;
+  uint8_t *counts; /* counts[unit * size + color_id], units as in grid_unit() */
+  bool is_consistent;
+} units_t;
 
-  for (size_t row = 0; row < grid->size; row++) {
+/* Set `units` up on `grid`, `counts` has room for 3 * size * size counts */
+static void units_init(units_t *units, grid_t *grid, uint8_t *counts) {
+
+  size_t size = grid->size;
+
+  memset(counts, UNIT_COUNT_UNKNOWN, 3 * size * size);
+  *units = (units_t){.grid = grid,
+                     .size_sqrt = get_sqrt(size),
+                     .counts = counts,
+                     .is_consistent = true};
+}
+
+/* Write the row, column and block of `cell` in `unit_ids` */
+static void units_of_cell(const units_t *units, const size_t cell,
+                          size_t unit_ids[3]) {
+
+  size_t size = units->grid->size;
+  size_t size_sqrt = units->size_sqrt;
+  size_t row = cell / size;
+  size_t column = cell % size;
+
+  unit_ids[0] = row;
+  unit_ids[1] = size + column;
+  unit_ids[2] = 2 * size + (row / size_sqrt) * size_sqrt + column / size_sqrt;
+}
+
+/* Return the `index`-th cell of `unit` */
+static size_t units_cell(const units_t *units, const size_t unit,
+                         const size_t index) {
+
+  size_t size = units->grid->size;
+  size_t size_sqrt = units->size_sqrt;
+
+  if (unit < size) {
+    return unit * size + index;
+  }
+  if (unit < 2 * size) {
+    return index * size + unit - size;
+  }
 
-    if (row < row_excluded_start || row > row_excluded_end) {
+  size_t block = unit - 2 * size;
+  size_t row = (block / size_sqrt) * size_sqrt + index / size_sqrt;
+  size_t column = (block % size_sqrt) * size_sqrt + index % size_sqrt;
 
-      colors_t *cell_colors = &grid->cells[row][column];
-      colors_t colors_removed_from_cell =
-          colors_discard_B_from_A(*cell_colors, colors_to_remove);
+  return row * size + column;
+}
 
-      if (!colors_is_singleton(*cell_colors) &&
-          colors_removed_from_cell != *cell_colors) {
-        changed = true;
-        *cell_colors = colors_removed_from_cell;
+/* Record that `cell` lost `color_id`, return False if one of its units is
+ * left without the color */
+static bool units_remove(units_t *units, const size_t cell,
+                         const size_t color_id) {
+
+  size_t size = units->grid->size;
+  const colors_t *cells = units->grid->cells[0];
+  colors_t color = (colors_t)1 << color_id;
+  size_t unit_ids[3];
+
+  units_of_cell(units, cell, unit_ids);
+  for (size_t i = 0; i < 3; i++) {
+    uint8_t *count = &units->counts[unit_ids[i] * size + color_id];
+
+    if (*count == UNIT_COUNT_UNKNOWN) {
+      *count = 0;
+      for (size_t j = 0; j < size; j++) {
+        if ((cells[units_cell(units, unit_ids[i], j)] & color) != 0) {
+          (*count)++;
+        }
       }
+    } else {
+      (*count)--;
+    }
+
+    if (*count == 0) {
+      units->is_consistent = false;
+      return false;
     }
   }
-  return changed;
+
+  return true;
 }
 
-/** Return
- *  + True if 'locked_candidates' heuristic could be applied on subgrid
- *  + False otherwise
+/**
+ * Record that `cell` lost the colors `removed`. Return False if the grid is
+ * left inconsistent: the cell is empty, one of its units is left without a
+ * removed color, or the cell is solved with the color of a solved peer.
  */
-static bool subgrid_locked_candidates(grid_t *grid, colors_t *subgrid[],
-                                      size_t block_start_row,
-                                      size_t block_start_column) {
+static bool units_discard(units_t *units, const size_t cell,
+                          colors_t removed) {
 
-  /* locked candidates on row */;
-  bool changed = false;
-  size_t size_sqrt = get_sqrt(grid->size);
-  colors_t row_colors[size_sqrt]; /* colors in the same row of subgrid*/
-  size_t index = 0;
+  const colors_t *cells = units->grid->cells[0];
+  colors_t colors = cells[cell];
 
-  changed |= cross_hatching(subgrid, grid->size);
+  if (colors == 0) {
+    units->is_consistent = false;
+    return false;
+  }
 
-  for (size_t i = 0; i < grid->size; i += size_sqrt) {
-    colors_t colors = 0;
-    for (size_t j = 0; j < size_sqrt; j++) {
-      if (!colors_is_singleton(*subgrid[i + j])) {
-        colors = colors_or(colors, *subgrid[i + j]);
-      }
+  while (removed != 0) {
+    colors_t color = removed & (~removed + 1);
+
+    removed &= removed - 1;
+    if (!units_remove(units, cell, colors_count(color - 1))) {
+      return false;
     }
-    row_colors[index] = colors;
-    index++;
   }
 
-  for (size_t row = 0; row < size_sqrt; row++) {
-    colors_t colors = 0;
-    for (size_t j = 0; j < size_sqrt; j++) {
+  if ((colors & (colors - 1)) == 0) {
+    size_t unit_ids[3];
+
+    units_of_cell(units, cell, unit_ids);
+    for (size_t i = 0; i < 3; i++) {
+      for (size_t j = 0; j < units->grid->size; j++) {
+        size_t other = units_cell(units, unit_ids[i], j);
 
-      if (row != j) {
-        colors = colors_or(colors, row_colors[j]);
+        if (other != cell && cells[other] == colors) {
+          units->is_consistent = false;
+          return false;
+        }
       }
     }
-    colors_t colors_to_remove =
-        colors_and(colors_negate(colors), row_colors[row]);
-    if (colors_to_remove != 0) {
-      changed |= remove_colors_from_row(
-          grid, colors_to_remove, row + block_start_row, block_start_column,
-          block_start_column + size_sqrt - 1);
-    }
   }
 
-  /* locked candidates on column */;
+  return true;
+}
+
+static bool grid_is_solved(grid_t *grid) {
 
-  colors_t column_colors[size_sqrt]; /*colors in the same column of subgrid*/
-  index = 0;
+  for (size_t i = 0; i < grid->size; i++) {
 
-  for (size_t i = 0; i < size_sqrt; i++) {
-    colors_t colors = 0;
-    for (size_t j = 0; j < grid->size; j += size_sqrt) {
-      if (!colors_is_singleton(*subgrid[i + j])) {
-        colors = colors_or(colors, *subgrid[i + j]);
+    for (size_t j = 0; j < grid->size; j++) {
+
+      if (!colors_is_singleton(grid->cells[i][j])) {
+        return false;
       }
     }
-    column_colors[index] = colors;
-    index++;
   }
 
-  for (size_t column = 0; column < size_sqrt; column++) {
-    colors_t colors = 0;
-    for (size_t j = 0; j < size_sqrt; j++) {
+  return true;
+}
 
-      if (column != j) {
-        colors = colors_or(colors, column_colors[j]);
-      }
+/* Intersections of the blocks with the rows and the columns, as segments of
+ * size_sqrt cells, for the locked candidates */
+typedef struct {
+  grid_t *grid;
+  size_t size_sqrt;
+  colors_t *rows;    /* rows[row * size_sqrt + column / size_sqrt] */
+  colors_t *columns; /* columns[column * size_sqrt + row / size_sqrt] */
+  colors_t *solved;  /* Colors of the solved cells, rows then columns */
+  uint64_t touched[UNITS_WORDS]; /* Units whose segments changed */
+  uint64_t *dirty;               /* Units which lost colors */
+  units_t *units;
+  bool changed;
+} intersections_t;
+
+/* Compute the colors of the two segments of the cell */
+static void intersections_update(intersections_t *inter, const size_t row,
+                                 const size_t column) {
+
+  colors_t **cells = inter->grid->cells;
+  size_t size_sqrt = inter->size_sqrt;
+  size_t row_start = (row / size_sqrt) * size_sqrt;
+  size_t column_start = (column / size_sqrt) * size_sqrt;
+  size_t row_index = row * size_sqrt + column / size_sqrt;
+  size_t column_index = column * size_sqrt + row / size_sqrt;
+  colors_t row_colors = 0;
+  colors_t column_colors = 0;
+  colors_t row_solved = 0;
+  colors_t column_solved = 0;
+
+  for (size_t i = 0; i < size_sqrt; i++) {
+    colors_t colors = cells[row][column_start + i];
+    row_colors = colors_or(row_colors, colors);
+    if (colors_is_singleton(colors)) {
+      row_solved = colors_or(row_solved, colors);
     }
-    colors_t colors_to_remove =
-        colors_and(colors_negate(colors), column_colors[column]);
-    if (colors_to_remove != 0) {
-      changed |= remove_colors_from_column(
-          grid, colors_to_remove, column + block_start_column, block_start_row,
-          block_start_row + size_sqrt - 1);
+
+    colors = cells[row_start + i][column];
+    column_colors = colors_or(column_colors, colors);
+    if (colors_is_singleton(colors)) {
+      column_solved = colors_or(column_solved, colors);
     }
   }
 
-  return changed;
+  inter->rows[row_index] = row_colors;
+  inter->columns[column_index] = column_colors;
+  inter->solved[row_index] = row_solved;
+  inter->solved[inter->grid->size * size_sqrt + column_index] = column_solved;
 }
 
-size_t grid_heuristics(grid_t *grid, bool use_locked_candidates) {
+/* Remove `colors` from the cell, its units are looked at again */
+static void intersections_discard(intersections_t *inter, const size_t row,
+                                  const size_t column, const colors_t colors) {
 
-  bool is_fixpoint_not_reached = true;
+  colors_t cell = inter->grid->cells[row][column];
 
-  while (is_fixpoint_not_reached) {
+  if (colors_and(cell, colors) == 0) {
+    return;
+  }
 
-    is_fixpoint_not_reached = false;
-    colors_t *subgrid[grid->size];
-    size_t index;
+  cell_write(inter->grid, row * inter->grid->size + column,
+             colors_discard_B_from_A(cell, colors));
+  units_discard(inter->units, row * inter->grid->size + column,
+                colors_and(cell, colors));
+  inter->changed = true;
+  intersections_update(inter, row, column);
+  units_mark_cell(inter->touched, inter->grid->size, row, column);
+  units_mark_cell(inter->dirty, inter->grid->size, row, column);
+}
 
-    for (size_t row = 0; row < grid->size; row++) {
-      index = 0;
+/* Return the colors of `segments[i]` found in no other of the `size_sqrt`
+ * segments, each `step` apart. The colors solved in `segments[i]` are left
+ * to the cross-hatching. */
+static colors_t intersections_only(const intersections_t *inter,
+                                   const colors_t *segments, const size_t i,
+                                   const size_t step) {
 
-      for (size_t column = 0; column < grid->size; column++) {
-        subgrid[index] = &grid->cells[row][column];
-        index++;
-      }
+  colors_t others = 0;
+  size_t offset = (segments - inter->rows) + i * step;
 
-      is_fixpoint_not_reached |= subgrid_heuristics(subgrid, grid->size);
-      if (!subgrid_consistency(subgrid, grid->size)) {
-        return status_code_grid_is_inconsistent;
-      }
+  for (size_t j = 0; j < inter->size_sqrt; j++) {
+    if (j != i) {
+      others = colors_or(others, segments[j * step]);
     }
+  }
 
-    for (size_t column = 0; column < grid->size; column++) {
-      index = 0;
+  return colors_subtract(colors_subtract(segments[i * step], others),
+                         inter->solved[offset]);
+}
 
-      for (size_t row = 0; row < grid->size; row++) {
-        subgrid[index] = &grid->cells[row][column];
-        index++;
-      }
+/* Pointing: the colors of a block confined to one of its rows (columns) are
+ * removed from the rest of that row (column) */
+static void intersections_pointing(intersections_t *inter, const size_t block) {
+
+  size_t size = inter->grid->size;
+  size_t size_sqrt = inter->size_sqrt;
+  size_t row_start = (block / size_sqrt) * size_sqrt;
+  size_t column_start = (block % size_sqrt) * size_sqrt;
 
-      is_fixpoint_not_reached |= subgrid_heuristics(subgrid, grid->size);
-      if (!subgrid_consistency(subgrid, grid->size)) {
-        return status_code_grid_is_inconsistent;
+  for (size_t i = 0; i < size_sqrt; i++) {
+    size_t row = row_start + i;
+    colors_t only = intersections_only(
+        inter, &inter->rows[row_start * size_sqrt + block % size_sqrt], i,
+        size_sqrt);
+
+    for (size_t column = 0; column < size && only != 0; column++) {
+      if (column < column_start || column >= column_start + size_sqrt) {
+        intersections_discard(inter, row, column, only);
       }
     }
+  }
 
-    size_t size_sqrt = get_sqrt(grid->size);
+  for (size_t i = 0; i < size_sqrt; i++) {
+    size_t column = column_start + i;
+    colors_t only = intersections_only(
+        inter, &inter->columns[column_start * size_sqrt + block / size_sqrt],
+        i, size_sqrt);
+
+    for (size_t row = 0; row < size && only != 0; row++) {
+      if (row < row_start || row >= row_start + size_sqrt) {
+        intersections_discard(inter, row, column, only);
+      }
+    }
+  }
+}
 
-    for (size_t block = 0; block < grid->size; block++) {
-      index = 0;
-      size_t row_start = ((block / size_sqrt) * size_sqrt);
+/* Claiming: the colors of a row (column) confined to one block are removed
+ * from the rest of that block */
+static void intersections_claiming(intersections_t *inter, const size_t line,
+                                   const bool is_row) {
 
-      for (size_t row = row_start; row < size_sqrt + row_start; row++) {
-        size_t column_start = ((block % size_sqrt) * size_sqrt);
+  size_t size_sqrt = inter->size_sqrt;
+  size_t line_start = (line / size_sqrt) * size_sqrt;
+  colors_t *segments = is_row ? &inter->rows[line * size_sqrt]
+                              : &inter->columns[line * size_sqrt];
 
-        for (size_t column = column_start; column < size_sqrt + column_start;
-             column++) {
-          subgrid[index] = &grid->cells[row][column];
-          index++;
+  for (size_t i = 0; i < size_sqrt; i++) {
+    colors_t only = intersections_only(inter, segments, i, 1);
+
+    for (size_t other = line_start; other < line_start + size_sqrt && only != 0;
+         other++) {
+      for (size_t j = i * size_sqrt; other != line && j < (i + 1) * size_sqrt;
+           j++) {
+        if (is_row) {
+          intersections_discard(inter, other, j, only);
+        } else {
+          intersections_discard(inter, j, other, only);
         }
       }
-
-      is_fixpoint_not_reached |= subgrid_heuristics(subgrid, grid->size);
-      if (!subgrid_consistency(subgrid, grid->size)) {
-        return status_code_grid_is_inconsistent;
-      }
     }
+  }
+}
 
-    if (use_locked_candidates && !is_fixpoint_not_reached) {
-
-      for (size_t block = 0; block < grid->size; block++) {
-        colors_t *subgrid[grid->size];
-        size_t index = 0;
-        size_t row_start = ((block / size_sqrt) * size_sqrt);
-        size_t column_start = ((block % size_sqrt) * size_sqrt);
+/**
+ * Apply the locked candidates, pointing and claiming, until none applies.
+ * The units are only looked at again once one of their segments changed.
+ * The eliminations are recorded in `units` and the units of the cells which
+ * lost colors are marked in `dirty`. Return True if the grid changed.
+ */
+static bool grid_intersections(grid_t *grid, units_t *units,
+                               uint64_t *dirty) {
 
-        for (size_t row = row_start; row < size_sqrt + row_start; row++) {
+  size_t size = grid->size;
+  size_t size_sqrt = get_sqrt(size);
+  colors_t segments[2 * size * size_sqrt];
+  colors_t solved[2 * size * size_sqrt];
+  intersections_t inter = {.grid = grid,
+                           .size_sqrt = size_sqrt,
+                           .rows = segments,
+                           .columns = &segments[size * size_sqrt],
+                           .solved = solved,
+                           .touched = {0},
+                           .dirty = dirty,
+                           .units = units,
+                           .changed = false};
 
-          for (size_t column = column_start; column < size_sqrt + column_start;
-               column++) {
+  for (size_t i = 0; i < size; i++) {
+    /* The diagonal of each block updates all of its segments */
+    for (size_t j = 0; j < size_sqrt; j++) {
+      size_t row = (i / size_sqrt) * size_sqrt + j;
+      size_t column = (i % size_sqrt) * size_sqrt + j;
+      intersections_update(&inter, row, column);
+    }
+  }
+  for (size_t unit = 0; unit < 3 * size; unit++) {
+    bitset_add(inter.touched, unit);
+  }
 
-            subgrid[index] = &grid->cells[row][column];
-            index++;
-          }
-        }
+  for (size_t word = 0; word < UNITS_WORDS && units->is_consistent;) {
+    if (inter.touched[word] == 0) {
+      word++;
+      continue;
+    }
 
-        is_fixpoint_not_reached |=
-            subgrid_locked_candidates(grid, subgrid, row_start, column_start);
+    size_t unit =
+        word * 64 + colors_count(colors_rightmost(inter.touched[word]) - 1);
+    bitset_discard(inter.touched, unit);
 
-        if (block % size_sqrt == 0 && !grid_is_consistent(grid)) {
-          return status_code_grid_is_inconsistent;
-        }
-      }
+    if (unit < size) {
+      intersections_claiming(&inter, unit, true);
+    } else if (unit < 2 * size) {
+      intersections_claiming(&inter, unit - size, false);
+    } else {
+      intersections_pointing(&inter, unit - 2 * size);
     }
+
+    /* Units before `unit` may have been touched again */
+    word = 0;
   }
 
-  return grid_is_solved(grid) ? status_code_grid_is_solved
-                              : status_code_grid_is_not_solved_and_consistent;
+  return inter.changed;
 }
 
-void grid_choice_free(choice_t *choice) { free(choice); }
+/* Fish searched for one color, the base lines being rows or columns */
+typedef struct {
+  grid_t *grid;
+  colors_t color;
+  bool on_columns;
+  size_t size_sqrt;
+  colors_t positions[MAX_GRID_SIZE]; /* Positions of the color on each line */
+  size_t lines[MAX_GRID_SIZE];       /* Lines which can be part of a fish */
+  size_t nb_lines;
+  size_t order;
+  units_t *units;
+  bool changed;
+} fish_t;
+
+static size_t fish_max_order = DEFAULT_FISH_ORDER;
+static bool fish_finned = false;
+
+void grid_set_fish(const size_t max_order, const bool finned) {
+
+  fish_max_order = max_order;
+  fish_finned = finned;
+}
 
-bool grid_choice_is_empty(const choice_t *choice) { return choice->color == 0; }
+/* Return the cell at position `pos` of the base line `line` */
+static colors_t *fish_cell(const fish_t *fish, const size_t line,
+                           const size_t pos) {
+
+  return fish->on_columns ? &fish->grid->cells[pos][line]
+                          : &fish->grid->cells[line][pos];
+}
+
+/* Remove the color from the cells of the lines in `lines` at the positions in
+ * `cover`, except on the base lines of the fish */
+static void fish_eliminate(fish_t *fish, const colors_t base,
+                           const colors_t lines, const colors_t cover) {
+
+  for (size_t line = 0; line < fish->grid->size; line++) {
+    if (!colors_is_in(lines, line) || colors_is_in(base, line) ||
+        colors_and(fish->positions[line], cover) == 0) {
+      continue;
+    }
+
+    for (size_t pos = 0; pos < fish->grid->size; pos++) {
+      colors_t *cell = fish_cell(fish, line, pos);
+
+      if (colors_is_in(cover, pos) && !colors_is_singleton(*cell) &&
+          colors_and(*cell, fish->color) != 0) {
+        cell_write(fish->grid, cell - fish->grid->cells[0],
+                   colors_subtract(*cell, fish->color));
+        units_discard(fish->units, cell - fish->grid->cells[0], fish->color);
+        fish->changed = true;
+      }
+    }
+  }
+}
+
+/**
+ * The base lines cover `order` positions plus fins. Either no fin holds the
+ * color and the plain fish applies, or one does and the color is in the box
+ * of the fins: the cover cells of that box lose the color in both cases.
+ */
+static void fish_finned_eliminate(fish_t *fish, const colors_t base,
+                                  const colors_t cover) {
+
+  size_t size_sqrt = fish->size_sqrt;
+  size_t nb_fins = colors_count(cover) - fish->order;
+  colors_t band_mask = colors_full(size_sqrt);
+
+  for (size_t band = 0; band < size_sqrt; band++) {
+    colors_t band_positions = band_mask << (band * size_sqrt);
+    colors_t candidates = colors_and(cover, band_positions);
+
+    /* Every subset of the band positions with the right size may be fins */
+    for (colors_t fins = candidates; fins != 0;
+         fins = colors_and(fins - 1, candidates)) {
+
+      if (colors_count(fins) != nb_fins) {
+        continue;
+      }
+
+      /* All the fins must be in a single box */
+      colors_t fin_lines = 0;
+      for (size_t line = 0; line < fish->grid->size; line++) {
+        if (colors_is_in(base, line) &&
+            colors_and(fish->positions[line], fins) != 0) {
+          fin_lines = colors_add(fin_lines, line);
+        }
+      }
+
+      size_t fin_band = colors_count(colors_rightmost(fin_lines) - 1) /
+                        size_sqrt;
+      colors_t fin_band_lines = band_mask << (fin_band * size_sqrt);
+
+      if (colors_is_subset(fin_lines, fin_band_lines)) {
+        fish_eliminate(fish, base, fin_band_lines,
+                       colors_and(colors_subtract(cover, fins),
+                                  band_positions));
+      }
+    }
+  }
+}
+
+/* Extend the base lines with lines taken from `first` on, as long as they
+ * cover few enough positions */
+static void fish_search(fish_t *fish, const size_t first, const size_t depth,
+                        const colors_t base, const colors_t cover) {
+
+  size_t max_cover = fish->order + (fish_finned ? fish->size_sqrt : 0);
+
+  if (depth == fish->order) {
+    size_t nb_covered = colors_count(cover);
+
+    if (nb_covered == fish->order) {
+      fish_eliminate(fish, base, colors_full(fish->grid->size), cover);
+    } else if (nb_covered > fish->order) {
+      fish_finned_eliminate(fish, base, cover);
+    }
+    return;
+  }
+
+  for (size_t i = first; i + fish->order - depth <= fish->nb_lines; i++) {
+    size_t line = fish->lines[i];
+    colors_t new_cover = colors_or(cover, fish->positions[line]);
+
+    if (colors_count(new_cover) <= max_cover) {
+      fish_search(fish, i + 1, depth + 1, colors_add(base, line), new_cover);
+    }
+  }
+}
+
+/**
+ * Look for X-Wings, Swordfishes and Jellyfishes (and finned ones if enabled)
+ * up to `fish_max_order`, with rows then columns as base lines. Return True if
+ * the grid changed.
+ */
+static bool grid_fish(grid_t *grid, units_t *units) {
+
+  fish_t fish = {
+      .grid = grid, .size_sqrt = get_sqrt(grid->size), .units = units};
+  size_t max_extra = fish_finned ? fish.size_sqrt : 0;
+
+  /* Bitboards of the unsolved cells of every color, by rows and by columns */
+  colors_t row_positions[grid->size][grid->size];
+  colors_t column_positions[grid->size][grid->size];
+  colors_t placed_on_rows[grid->size];
+  colors_t placed_on_columns[grid->size];
+
+  memset(row_positions, 0, sizeof(row_positions));
+  memset(column_positions, 0, sizeof(column_positions));
+
+  for (size_t i = 0; i < grid->size; i++) {
+    placed_on_rows[i] = 0;
+    placed_on_columns[i] = 0;
+  }
+
+  for (size_t row = 0; row < grid->size; row++) {
+    for (size_t column = 0; column < grid->size; column++) {
+      colors_t colors = grid->cells[row][column];
+
+      if (colors_is_singleton(colors)) {
+        placed_on_rows[row] = colors_or(placed_on_rows[row], colors);
+        placed_on_columns[column] = colors_or(placed_on_columns[column], colors);
+        continue;
+      }
+
+      while (colors != 0) {
+        colors_t color = colors_rightmost(colors);
+        size_t color_id = colors_count(color - 1);
+
+        row_positions[color_id][row] =
+            colors_add(row_positions[color_id][row], column);
+        column_positions[color_id][column] =
+            colors_add(column_positions[color_id][column], row);
+        colors = colors_subtract(colors, color);
+      }
+    }
+  }
+
+  for (size_t color_id = 0; color_id < grid->size; color_id++) {
+    fish.color = colors_set(color_id);
+
+    for (size_t on_columns = 0; on_columns < 2; on_columns++) {
+      fish.on_columns = on_columns;
+
+      /* Lines where the color is already placed are left out */
+      for (size_t line = 0; line < grid->size; line++) {
+        bool is_placed = colors_is_in(
+            on_columns ? placed_on_columns[line] : placed_on_rows[line],
+            color_id);
+
+        fish.positions[line] =
+            is_placed ? 0
+                      : (on_columns ? column_positions[color_id][line]
+                                    : row_positions[color_id][line]);
+      }
+
+      for (fish.order = 2; fish.order <= fish_max_order; fish.order++) {
+        fish.nb_lines = 0;
+
+        for (size_t line = 0; line < grid->size; line++) {
+          size_t count = colors_count(fish.positions[line]);
+
+          if (count >= 2 && count <= fish.order + max_extra) {
+            fish.lines[fish.nb_lines++] = line;
+          }
+        }
+
+        fish_search(&fish, 0, 0, colors_empty(), colors_empty());
+      }
+    }
+  }
+
+  return fish.changed;
+}
+
+/**
+ * Implications between candidates, used by the chain search. A candidate
+ * (literal) is a color in a cell, numbered (row * size + column) * size +
+ * color. Setting a literal true or false implies others through links:
+ * + weak links: a true literal makes false the other colors of its cell and
+ *   its color in the peer cells,
+ * + strong links: a false literal makes true the other color of its cell if
+ *   it has two colors, and the other position of its color in each of its
+ *   units holding that color twice.
+ * Literals are marked with the number of the current propagation so that
+ * nothing has to be cleared between two of them.
+ */
+typedef struct {
+  grid_t *grid;
+  size_t size;
+  size_t size_sqrt;
+  size_t max_length;   /* Maximal number of links followed from the start */
+  uint32_t generation; /* Number of the current propagation */
+  uint32_t *true_mark;
+  uint32_t *false_mark;
+  uint32_t *queue;      /* Marked literals (literal * 2 + value) to follow */
+  uint8_t *queue_depth; /* Number of links leading to each queued literal */
+  size_t queue_length;
+  colors_t *positions; /* Positions of each color in each unit */
+  uint8_t *nb_false;   /* Branches in which each literal was made false */
+  uint32_t *touched;   /* Literals whose `nb_false` is not zero */
+  size_t nb_touched;
+  units_t *units;
+} chains_t;
+
+static size_t chain_max_length = DEFAULT_CHAIN_LENGTH;
+static double chain_budget = DEFAULT_CHAIN_BUDGET;
+
+void grid_set_chains(const size_t max_length, const double budget_ms) {
+
+  chain_max_length = max_length;
+  chain_budget = budget_ms;
+}
+
+/* Return the unit of type `type` (0 row, 1 column, 2 block) of a cell */
+static size_t chains_unit(const chains_t *chains, const size_t type,
+                          const size_t row, const size_t column) {
+
+  size_t size_sqrt = chains->size_sqrt;
+
+  switch (type) {
+  case 0:
+    return row;
+  case 1:
+    return chains->size + column;
+  default:
+    return 2 * chains->size + (row / size_sqrt) * size_sqrt +
+           column / size_sqrt;
+  }
+}
+
+/* Return the cell (row * size + column) at position `pos` of `unit` */
+static size_t chains_unit_cell(const chains_t *chains, const size_t unit,
+                               const size_t pos) {
+
+  size_t size = chains->size;
+  size_t size_sqrt = chains->size_sqrt;
+
+  if (unit < size) {
+    return unit * size + pos;
+  }
+  if (unit < 2 * size) {
+    return pos * size + (unit - size);
+  }
+
+  size_t block = unit - 2 * size;
+  size_t row = (block / size_sqrt) * size_sqrt + pos / size_sqrt;
+  size_t column = (block % size_sqrt) * size_sqrt + pos % size_sqrt;
+
+  return row * size + column;
+}
+
+/* Mark a literal with `value`, return False if it was marked the other way */
+static bool chains_mark(chains_t *chains, const uint32_t literal,
+                        const bool value, const size_t depth) {
+
+  uint32_t *same_mark = value ? chains->true_mark : chains->false_mark;
+  uint32_t *other_mark = value ? chains->false_mark : chains->true_mark;
+
+  if (other_mark[literal] == chains->generation) {
+    return false;
+  }
+
+  if (same_mark[literal] != chains->generation) {
+    same_mark[literal] = chains->generation;
+    chains->queue[chains->queue_length] = literal * 2 + value;
+    chains->queue_depth[chains->queue_length] = depth;
+    chains->queue_length++;
+  }
+
+  return true;
+}
+
+/* Follow the links from `literal` set to `value`, at most `max_length` links
+ * away. Return False if the propagation reached a contradiction. */
+static bool chains_propagate(chains_t *chains, const uint32_t literal,
+                             const bool value) {
+
+  size_t size = chains->size;
+
+  /* Marks left by the propagations of a previous wrap could match again */
+  if (++chains->generation == 0) {
+    size_t nb_literals = size * size * size;
+    memset(chains->true_mark, 0, nb_literals * sizeof(uint32_t));
+    memset(chains->false_mark, 0, nb_literals * sizeof(uint32_t));
+    chains->generation = 1;
+  }
+  chains->queue_length = 0;
+  chains_mark(chains, literal, value, 0);
+
+  for (size_t next = 0; next < chains->queue_length; next++) {
+
+    uint32_t current = chains->queue[next] / 2;
+    bool current_value = chains->queue[next] % 2;
+    size_t depth = chains->queue_depth[next];
+
+    if (depth == chains->max_length) {
+      continue;
+    }
+
+    size_t cell = current / size;
+    size_t color_id = current % size;
+    size_t row = cell / size;
+    size_t column = cell % size;
+    colors_t cell_colors = chains->grid->cells[row][column];
+
+    /* The literal was removed during this pass: nothing to follow */
+    if (!colors_is_in(cell_colors, color_id)) {
+      continue;
+    }
+
+    if (current_value) {
+      /* Weak links: the other colors of the cell and the peers */
+      colors_t others = colors_discard(cell_colors, color_id);
+
+      for (size_t other = 0; others != 0; other++) {
+        if (colors_is_in(others, other)) {
+          others = colors_discard(others, other);
+          if (!chains_mark(chains, cell * size + other, false, depth + 1)) {
+            return false;
+          }
+        }
+      }
+
+      for (size_t type = 0; type < 3; type++) {
+        size_t unit = chains_unit(chains, type, row, column);
+        colors_t positions = chains->positions[unit * size + color_id];
+
+        for (size_t pos = 0; positions != 0; pos++) {
+          if (!colors_is_in(positions, pos)) {
+            continue;
+          }
+          positions = colors_discard(positions, pos);
+
+          size_t peer = chains_unit_cell(chains, unit, pos);
+          if (peer != cell &&
+              !chains_mark(chains, peer * size + color_id, false, depth + 1)) {
+            return false;
+          }
+        }
+      }
+    } else {
+      /* Strong links: bivalue cell and bilocal color in a unit */
+      if (colors_count(cell_colors) == 2) {
+        colors_t other = colors_discard(cell_colors, color_id);
+        if (!chains_mark(chains, cell * size + colors_count(other - 1), true,
+                         depth + 1)) {
+          return false;
+        }
+      }
+
+      for (size_t type = 0; type < 3; type++) {
+        size_t unit = chains_unit(chains, type, row, column);
+        colors_t positions = chains->positions[unit * size + color_id];
+
+        if (colors_count(positions) != 2) {
+          continue;
+        }
+
+        for (size_t pos = 0; pos < size; pos++) {
+          size_t peer = chains_unit_cell(chains, unit, pos);
+
+          if (colors_is_in(positions, pos) && peer != cell &&
+              !chains_mark(chains, peer * size + color_id, true, depth + 1)) {
+            return false;
+          }
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+/* Return True if the two literals can not be both true */
+static bool chains_see(const chains_t *chains, const uint32_t literal1,
+                       const uint32_t literal2) {
+
+  size_t size = chains->size;
+  size_t cell1 = literal1 / size;
+  size_t cell2 = literal2 / size;
+
+  if (cell1 == cell2) {
+    return literal1 != literal2;
+  }
+  if (literal1 % size != literal2 % size) {
+    return false;
+  }
+
+  size_t row1 = cell1 / size, column1 = cell1 % size;
+  size_t row2 = cell2 / size, column2 = cell2 % size;
+
+  return row1 == row2 || column1 == column2 ||
+         chains_unit(chains, 2, row1, column1) ==
+             chains_unit(chains, 2, row2, column2);
+}
+
+/* Remove a literal from the grid, return True if it was there */
+static bool chains_eliminate(chains_t *chains, const uint32_t literal) {
+
+  size_t size = chains->size;
+  size_t cell = literal / size;
+  colors_t colors = chains->grid->cells[0][cell];
+
+  if (colors_is_singleton(colors) || !colors_is_in(colors, literal % size)) {
+    return false;
+  }
+
+  cell_write(chains->grid, cell, colors_discard(colors, literal % size));
+  units_discard(chains->units, cell, colors_set(literal % size));
+
+  return true;
+}
+
+/**
+ * Alternating inference chains from `start`: if it is false, every literal
+ * reached true (through a strong link) holds, so one of the two ends of the
+ * chain is true and the literals seeing both ends are false. This covers
+ * X-chains (a single color) and XY-chains (bivalue cells only).
+ */
+static bool chains_from_literal(chains_t *chains, const uint32_t start) {
+
+  size_t size = chains->size;
+  bool changed = false;
+
+  if (!chains_propagate(chains, start, false)) {
+    /* `start` can not be false */
+    colors_t colors = chains->grid->cells[0][start / size];
+
+    cell_write(chains->grid, start / size, colors_set(start % size));
+    units_discard(chains->units, start / size,
+                  colors_discard(colors, start % size));
+    return true;
+  }
+
+  size_t start_cell = start / size;
+  size_t start_row = start_cell / size;
+  size_t start_column = start_cell % size;
+  size_t queue_length = chains->queue_length;
+
+  for (size_t i = 1; i < queue_length; i++) {
+
+    if (chains->queue[i] % 2 == 0) {
+      continue;
+    }
+    uint32_t end = chains->queue[i] / 2;
+
+    /* Literals seeing the start: other colors of its cell and its color in
+     * the peers */
+    colors_t start_colors = chains->grid->cells[start_row][start_column];
+    for (size_t color_id = 0; color_id < size; color_id++) {
+      uint32_t literal = start_cell * size + color_id;
+
+      if (colors_is_in(start_colors, color_id) && literal != start &&
+          chains_see(chains, literal, end)) {
+        changed |= chains_eliminate(chains, literal);
+      }
+    }
+
+    for (size_t type = 0; type < 3; type++) {
+      size_t unit = chains_unit(chains, type, start_row, start_column);
+
+      for (size_t pos = 0; pos < size; pos++) {
+        size_t peer = chains_unit_cell(chains, unit, pos);
+        uint32_t literal = peer * size + start % size;
+
+        if (peer != start_cell && literal != end &&
+            chains_see(chains, literal, end)) {
+          changed |= chains_eliminate(chains, literal);
+        }
+      }
+    }
+  }
+
+  return changed;
+}
+
+/**
+ * Cell forcing chains: one of the colors of `cell` is true, so the literals
+ * made false by every one of them are false. A color leading to a
+ * contradiction is removed.
+ */
+static bool chains_from_cell(chains_t *chains, const size_t cell) {
+
+  size_t size = chains->size;
+  colors_t colors = chains->grid->cells[0][cell];
+  size_t nb_branches = 0;
+  bool changed = false;
+
+  chains->nb_touched = 0;
+
+  for (size_t color_id = 0; color_id < size; color_id++) {
+
+    if (!colors_is_in(colors, color_id)) {
+      continue;
+    }
+
+    if (!chains_propagate(chains, cell * size + color_id, true)) {
+      cell_write(chains->grid, cell,
+                 colors_discard(chains->grid->cells[0][cell], color_id));
+      units_discard(chains->units, cell, colors_set(color_id));
+      changed = true;
+      continue;
+    }
+
+    nb_branches++;
+    for (size_t i = 0; i < chains->queue_length; i++) {
+      if (chains->queue[i] % 2 == 0) {
+        uint32_t literal = chains->queue[i] / 2;
+
+        if (chains->nb_false[literal]++ == 0) {
+          chains->touched[chains->nb_touched++] = literal;
+        }
+      }
+    }
+  }
+
+  for (size_t i = 0; i < chains->nb_touched; i++) {
+    uint32_t literal = chains->touched[i];
+
+    if (!changed && chains->nb_false[literal] == nb_branches) {
+      changed |= chains_eliminate(chains, literal);
+    }
+    chains->nb_false[literal] = 0;
+  }
+
+  return changed;
+}
+
+/* Seconds elapsed on a monotonic clock, the same for all the threads */
+static double grid_now(void) {
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static tss_t chains_key;
+static once_flag chains_once = ONCE_FLAG_INIT;
+
+static void chains_free(void *data) {
+
+  chains_t *chains = data;
+
+  if (chains == NULL) {
+    return;
+  }
+
+  free(chains->true_mark);
+  free(chains->false_mark);
+  free(chains->queue);
+  free(chains->queue_depth);
+  free(chains->positions);
+  free(chains->nb_false);
+  free(chains->touched);
+  free(chains);
+}
+
+static void chains_key_create(void) { tss_create(&chains_key, chains_free); }
+
+/* Return the buffers of the chains of the calling thread, allocated for the
+ * grids of `size` on first use and kept until a grid of another size comes.
+ * Return NULL if they can not be allocated. */
+static chains_t *chains_get(const size_t size) {
+
+  call_once(&chains_once, chains_key_create);
+
+  chains_t *chains = tss_get(chains_key);
+  if (chains != NULL && chains->size == size) {
+    return chains;
+  }
+
+  chains_free(chains);
+  tss_set(chains_key, NULL);
+
+  size_t nb_literals = size * size * size;
+  chains = calloc(1, sizeof(chains_t));
+  if (chains == NULL) {
+    return NULL;
+  }
+
+  chains->size = size;
+  chains->size_sqrt = get_sqrt(size);
+  chains->true_mark = calloc(nb_literals, sizeof(uint32_t));
+  chains->false_mark = calloc(nb_literals, sizeof(uint32_t));
+  chains->queue = malloc(2 * nb_literals * sizeof(uint32_t));
+  chains->queue_depth = malloc(2 * nb_literals * sizeof(uint8_t));
+  chains->positions = malloc(3 * size * size * sizeof(colors_t));
+  chains->nb_false = calloc(nb_literals, sizeof(uint8_t));
+  chains->touched = malloc(nb_literals * sizeof(uint32_t));
+
+  if (chains->true_mark == NULL || chains->false_mark == NULL ||
+      chains->queue == NULL || chains->queue_depth == NULL ||
+      chains->positions == NULL || chains->nb_false == NULL ||
+      chains->touched == NULL) {
+    chains_free(chains);
+    return NULL;
+  }
+
+  tss_set(chains_key, chains);
+
+  return chains;
+}
+
+/**
+ * Look for chains eliminations from every candidate, then for forcing chains
+ * from the cells with two or three colors, until the time budget is spent.
+ * Return True if the grid changed.
+ */
+static bool grid_chains(grid_t *grid, units_t *units) {
+
+  size_t size = grid->size;
+  double deadline = grid_now() + chain_budget / 1000;
+  bool changed = false;
+
+  chains_t *chains = chains_get(size);
+  if (chains == NULL) {
+    return false;
+  }
+
+  chains->grid = grid;
+  chains->units = units;
+  chains->max_length = chain_max_length;
+  memset(chains->positions, 0, 3 * size * size * sizeof(colors_t));
+
+  /* Positions of the colors among the unsolved cells of each unit. They are
+   * not updated on eliminations: extra positions only hide strong links. */
+  for (size_t row = 0; row < size; row++) {
+    for (size_t column = 0; column < size; column++) {
+      colors_t colors = grid->cells[row][column];
+
+      if (colors_is_singleton(colors)) {
+        continue;
+      }
+
+      for (size_t type = 0; type < 3; type++) {
+        size_t unit = chains_unit(chains, type, row, column);
+        size_t pos = (type == 0)   ? column
+                     : (type == 1) ? row
+                                   : (row % chains->size_sqrt) *
+                                             chains->size_sqrt +
+                                         column % chains->size_sqrt;
+
+        for (size_t color_id = 0; color_id < size; color_id++) {
+          if (colors_is_in(colors, color_id)) {
+            chains->positions[unit * size + color_id] = colors_add(
+                chains->positions[unit * size + color_id], pos);
+          }
+        }
+      }
+    }
+  }
+
+  for (size_t cell = 0; cell < size * size && grid_now() < deadline; cell++) {
+    for (size_t color_id = 0; color_id < size; color_id++) {
+      colors_t colors = grid->cells[cell / size][cell % size];
+
+      if (!colors_is_singleton(colors) && colors_is_in(colors, color_id)) {
+        changed |= chains_from_literal(chains, cell * size + color_id);
+      }
+    }
+  }
+
+  for (size_t cell = 0; cell < size * size && grid_now() < deadline; cell++) {
+    size_t count = colors_count(grid->cells[cell / size][cell % size]);
+
+    if (count == 2 || count == 3) {
+      changed |= chains_from_cell(chains, cell);
+    }
+  }
+
+  return changed;
+}
+
+/* Peers of the cells of the grids of each size, built once on first use */
+static _Atomic(uint16_t *) peers_tables[MAX_GRID_SIZE + 1];
+
+/* Return the number of peers of a cell: its row, column and block */
+static size_t peers_count(const size_t size) {
+
+  size_t size_sqrt = get_sqrt(size);
+
+  return 2 * (size - 1) + (size_sqrt - 1) * (size_sqrt - 1);
+}
+
+/* Return the peers of the cells of the grids of `size`, peers_count() per
+ * cell, NULL if they can not be allocated */
+static const uint16_t *peers_get(const size_t size) {
+
+  uint16_t *peers = atomic_load(&peers_tables[size]);
+  if (peers != NULL) {
+    return peers;
+  }
+
+  size_t nb_peers = peers_count(size);
+  size_t size_sqrt = get_sqrt(size);
+  peers = malloc(size * size * nb_peers * sizeof(uint16_t));
+  if (peers == NULL) {
+    return NULL;
+  }
+
+  uint16_t *peer = peers;
+  for (size_t row = 0; row < size; row++) {
+    for (size_t column = 0; column < size; column++) {
+      size_t row_start = (row / size_sqrt) * size_sqrt;
+      size_t column_start = (column / size_sqrt) * size_sqrt;
+
+      for (size_t other = 0; other < size; other++) {
+        if (other != column) {
+          *peer++ = row * size + other;
+        }
+      }
+      for (size_t other = 0; other < size; other++) {
+        if (other != row) {
+          *peer++ = other * size + column;
+        }
+      }
+      for (size_t r = row_start; r < row_start + size_sqrt; r++) {
+        for (size_t c = column_start; c < column_start + size_sqrt; c++) {
+          if (r != row && c != column) {
+            *peer++ = r * size + c;
+          }
+        }
+      }
+    }
+  }
+
+  /* Threads racing on the first grid of a size keep the first table */
+  uint16_t *expected = NULL;
+  if (!atomic_compare_exchange_strong(&peers_tables[size], &expected, peers)) {
+    free(peers);
+    return expected;
+  }
+
+  return peers;
+}
+
+/* Remove the color of each cell of `queue` from its peers, the peers left
+ * with one color are queued in turn. `queue` has room for all the cells.
+ * The eliminations are recorded in `units` unless it is NULL. Return False
+ * if a cell is emptied, or a unit is left without a color. */
+static bool singles_propagate(grid_t *grid, uint16_t *queue, size_t nb_queued,
+                              units_t *units) {
+
+  const uint16_t *peers = peers_get(grid->size);
+  if (peers == NULL) {
+    return true; /* The unit heuristics do the same work, only slower */
+  }
+
+  size_t nb_peers = peers_count(grid->size);
+  colors_t *cells = grid->cells[0];
+
+  while (nb_queued > 0) {
+    size_t cell = queue[--nb_queued];
+    colors_t color = cells[cell];
+    size_t color_id = colors_count(color - 1);
+    const uint16_t *peer = &peers[cell * nb_peers];
+
+    for (size_t i = 0; i < nb_peers; i++) {
+      colors_t *colors = &cells[peer[i]];
+
+      if ((*colors & color) != 0) {
+        cell_write(grid, peer[i], *colors & ~color);
+
+        if (*colors == 0 ||
+            (units != NULL && !units_remove(units, peer[i], color_id))) {
+          return false;
+        }
+        if (colors_is_singleton(*colors)) {
+          queue[nb_queued++] = peer[i];
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+/* Apply `heuristic` on every unit of `grid` and return True if it changed any
+ * of them. `units->is_consistent` is set to False on a contradiction. */
+static bool grid_units_heuristic(grid_t *grid,
+                                 bool (*heuristic)(colors_t *[], size_t),
+                                 units_t *units) {
+
+  bool changed = false;
+  colors_t *subgrid[grid->size];
+  colors_t saved[grid->size];
+  colors_t found[grid->size];
+
+  for (size_t unit = 0; unit < 3 * grid->size; unit++) {
+    grid_unit(grid, unit, subgrid);
+    for (size_t i = 0; i < grid->size; i++) {
+      saved[i] = *subgrid[i];
+    }
+
+    if (!heuristic(subgrid, grid->size)) {
+      continue;
+    }
+    changed = true;
+
+    /* The heuristics write through the pointers, the changes are written
+     * again one cell at a time so that the hash and the counts follow */
+    for (size_t i = 0; i < grid->size; i++) {
+      found[i] = *subgrid[i];
+      *subgrid[i] = saved[i];
+    }
+    for (size_t i = 0; i < grid->size; i++) {
+      size_t cell = subgrid[i] - grid->cells[0];
+
+      if (found[i] != saved[i]) {
+        cell_write(grid, cell, found[i]);
+        if (!units_discard(units, cell, colors_subtract(saved[i], found[i]))) {
+          return changed;
+        }
+      }
+    }
+
+    if (all_different_is_enabled() &&
+        !all_different_check(subgrid, grid->size)) {
+      units->is_consistent = false;
+      return changed;
+    }
+  }
+
+  return changed;
+}
+
+/* Cross-hatching then lone numbers */
+static bool singles(colors_t *subgrid[], size_t size) {
+
+  bool changed = cross_hatching(subgrid, size);
+  changed |= lone_number(subgrid, size);
+
+  return changed;
+}
+
+/* Naked subsets, or the matching filter which finds the subsets of every
+ * order, naked and hidden */
+static bool naked_subsets(colors_t *subgrid[], size_t size) {
+
+  return all_different_is_enabled() ? all_different(subgrid, size)
+                                    : naked_subset(subgrid, size);
+}
+
+/* Techniques of grid_heuristics(), from the cheapest to the most expensive */
+typedef enum {
+  tier_singles,
+  tier_naked_subsets,
+  tier_hidden_subsets,
+  tier_locked_candidates,
+  tier_fish,
+  tier_chains,
+  nb_tiers
+} tier_t;
+
+/* A technique is measured on this many runs before it can be skipped */
+#define SCHEDULE_WARMUP 32
+
+/* A technique is skipped when it removes fewer candidates than this per run
+ * on average. The profile counts the candidates rather than timing the runs,
+ * so that a solve does not depend on the load of the machine. */
+#define SCHEDULE_MIN_YIELD 0.5
+
+/* A skipped technique still runs once in this many times, to keep its
+ * measure up to date */
+#define SCHEDULE_RETRY 16
+
+/* Measures of the techniques in a thread since grid_schedule_reset() */
+typedef struct {
+  uint64_t nb_runs[nb_tiers];
+  uint64_t nb_eliminations[nb_tiers]; /* Candidates removed */
+  uint64_t nb_skips[nb_tiers];
+} schedule_stats_t;
+
+static schedule_t schedule = schedule_full;
+static _Thread_local schedule_stats_t schedule_stats;
+static _Thread_local bool schedule_is_probing; /* Calls of grid_probe() */
+
+void grid_set_schedule(const schedule_t profile) { schedule = profile; }
+
+void grid_schedule_reset(void) {
+
+  memset(&schedule_stats, 0, sizeof(schedule_stats));
+}
+
+/* Return the number of candidates left in the cells of `grid` */
+static size_t grid_candidates(const grid_t *grid) {
+
+  size_t nb_candidates = 0;
+
+  for (size_t cell = 0; cell < grid->size * grid->size; cell++) {
+    nb_candidates += colors_count(grid->cells[0][cell]);
+  }
+
+  return nb_candidates;
+}
+
+/* Return True if `tier` is worth running, from the candidates it removed per
+ * run so far in the adaptive profile. The probes use the profile without
+ * changing it. */
+static bool schedule_is_worth(const tier_t tier) {
+
+  schedule_stats_t *stats = &schedule_stats;
+
+  if (schedule == schedule_full || tier == tier_singles ||
+      stats->nb_runs[tier] < SCHEDULE_WARMUP ||
+      stats->nb_eliminations[tier] >=
+          SCHEDULE_MIN_YIELD * stats->nb_runs[tier]) {
+    return true;
+  }
+
+  return !schedule_is_probing &&
+         ++stats->nb_skips[tier] % SCHEDULE_RETRY == 0;
+}
+
+/* Run `tier` on `grid`, return True if it changed the grid. A contradiction
+ * clears `units->is_consistent`. */
+static bool schedule_run(grid_t *grid, const tier_t tier, units_t *units) {
+
+  uint64_t dirty[UNITS_WORDS] = {0};
+  bool changed = false;
+
+  switch (tier) {
+  case tier_singles:
+    changed = grid_units_heuristic(grid, singles, units);
+    break;
+
+  case tier_naked_subsets:
+    changed = grid_units_heuristic(grid, naked_subsets, units);
+    break;
+
+  case tier_hidden_subsets:
+    if (!all_different_is_enabled()) {
+      changed = grid_units_heuristic(grid, hidden_subset, units);
+    }
+    break;
+
+  case tier_locked_candidates:
+    changed = grid_intersections(grid, units, dirty);
+    if (units->is_consistent && !units_matching(grid, dirty)) {
+      units->is_consistent = false;
+    }
+    break;
+
+  case tier_fish:
+    changed = fish_max_order >= 2 && grid_fish(grid, units);
+    break;
+
+  case tier_chains:
+    changed = chain_max_length > 0 && grid_chains(grid, units);
+    break;
+
+  default:
+    break;
+  }
+
+  return changed;
+}
+
+size_t grid_heuristics(grid_t *grid, bool use_locked_candidates) {
+
+  schedule_stats_t *stats = &schedule_stats;
+  bool is_adaptive = schedule == schedule_adaptive && !schedule_is_probing;
+  size_t res = status_code_grid_is_not_solved_and_consistent;
+
+  /* The singles are propagated through the peers before the units are
+   * scanned, most cells of the easy grids are solved there */
+  uint8_t counts[3 * grid->size * grid->size];
+  units_t units;
+  units_init(&units, grid, counts);
+
+  uint16_t queue[grid->size * grid->size];
+  size_t nb_queued = 0;
+  for (size_t cell = 0; cell < grid->size * grid->size; cell++) {
+    if (colors_is_singleton(grid->cells[0][cell])) {
+      queue[nb_queued++] = cell;
+    }
+  }
+  if (!units_cover(grid) ||
+      !singles_propagate(grid, queue, nb_queued, &units)) {
+    return status_code_grid_is_inconsistent;
+  }
+
+  /* A tier only runs once the cheaper ones are stuck, and any change goes
+   * back to the singles */
+  tier_t last_tier = use_locked_candidates ? tier_chains : tier_hidden_subsets;
+  tier_t tier = tier_singles;
+
+  while (tier <= last_tier) {
+    if (!schedule_is_worth(tier)) {
+      tier++;
+      continue;
+    }
+
+    /* The singles always run, they are not measured */
+    bool is_measured = is_adaptive && tier != tier_singles;
+    size_t nb_candidates = is_measured ? grid_candidates(grid) : 0;
+    bool changed = schedule_run(grid, tier, &units);
+
+    if (is_measured) {
+      stats->nb_runs[tier]++;
+      stats->nb_eliminations[tier] += nb_candidates - grid_candidates(grid);
+    }
+
+    if (!units.is_consistent) {
+      res = status_code_grid_is_inconsistent;
+      break;
+    }
+
+    tier = changed ? tier_singles : tier + 1;
+  }
+
+  if (res != status_code_grid_is_inconsistent && grid_is_solved(grid)) {
+    res = status_code_grid_is_solved;
+  }
+
+  return res;
+}
+
+static size_t probe_budget = 0;
+
+void grid_set_probe(const size_t budget) { probe_budget = budget; }
+
+bool grid_probe(grid_t *grid) {
+
+  if (probe_budget == 0) {
+    return false;
+  }
+
+  size_t size = grid->size;
+  size_t nb_probes = 0;
+  bool changed = false;
+
+  /* Each probe runs on `grid` and is undone from the trail of its writes */
+  uint64_t recorded[(size * size + 63) / 64];
+  uint16_t trail_cells[size * size];
+  colors_t trail_colors[size * size];
+  trail_t trail = {
+      .recorded = recorded, .cells = trail_cells, .colors = trail_colors};
+  memset(recorded, 0, sizeof(recorded));
+
+  for (size_t row = 0; row < size; row++) {
+    for (size_t column = 0; column < size; column++) {
+
+      colors_t colors = grid->cells[row][column];
+      size_t count = colors_count(colors);
+
+      if (count < 2 || count > 3) {
+        continue;
+      }
+
+      for (size_t color_id = 0; color_id < size; color_id++) {
+
+        if (!colors_is_in(colors, color_id)) {
+          continue;
+        }
+        if (nb_probes++ == probe_budget) {
+          return changed;
+        }
+
+        grid_hash_t hash = grid->hash;
+        trail.nb_cells = 0;
+        grid->trail = &trail;
+
+        cell_write(grid, row * size + column, colors_set(color_id));
+        schedule_is_probing = true;
+        bool failed =
+            grid_heuristics(grid, false) == status_code_grid_is_inconsistent;
+        schedule_is_probing = false;
+
+        grid->trail = NULL;
+        for (size_t i = 0; i < trail.nb_cells; i++) {
+          size_t cell = trail.cells[i];
+
+          grid->cells[0][cell] = trail.colors[i];
+          recorded[cell / 64] &= ~((uint64_t)1 << cell % 64);
+        }
+        grid->hash = hash;
+
+        if (failed) {
+          /* The cell may be left empty, the next sweep reports it */
+          cell_write(grid, row * size + column,
+                     colors_discard(grid->cells[row][column], color_id));
+          changed = true;
+        }
+      }
+    }
+  }
+
+  return changed;
+}
+
+void grid_choice_free(choice_t *choice) { free(choice); }
+
+bool grid_choice_is_empty(const choice_t *choice) { return choice->color == 0; }
 
 void grid_choice_apply(grid_t *grid, const choice_t *choice) {
 
-  grid->cells[choice->row][choice->column] = choice->color;
+  cell_write(grid, choice->row * grid->size + choice->column, choice->color);
+}
+
+bool grid_choice_assign(grid_t *grid, const choice_t *choice) {
+
+  uint16_t queue[grid->size * grid->size];
+
+  queue[0] = choice->row * grid->size + choice->column;
+  cell_write(grid, queue[0], choice->color);
+
+  return singles_propagate(grid, queue, 1, NULL);
+}
+
+void grid_choice_blank(grid_t *grid, const choice_t *choice) {
+
+  cell_write(grid, choice->row * grid->size + choice->column,
+             colors_full(grid->size));
 }
 
 void grid_choice_discard(grid_t *grid, const choice_t *choice) {
@@ -615,7 +2226,7 @@ void grid_choice_discard(grid_t *grid, const choice_t *choice) {
       colors_discard_B_from_A(grid->cells[choice->row][choice->column],
                               choice->color); /* The choice is discarded */
 
-  grid->cells[choice->row][choice->column] = new_colors;
+  cell_write(grid, choice->row * grid->size + choice->column, new_colors);
 }
 
 void grid_choice_print(const choice_t *choice, FILE *fd) {
@@ -623,8 +2234,13 @@ void grid_choice_print(const choice_t *choice, FILE *fd) {
   for (size_t i = 0; i < MAX_GRID_SIZE; i++) {
 
     if (colors_is_in(choice->color, i)) {
-      fprintf(fd, "Grid[%ld][%ld]'s choice is '%c'.\n", choice->row,
-              choice->column, color_table[i]);
+      if (i < sizeof(color_table) - 1) {
+        fprintf(fd, "Grid[%ld][%ld]'s choice is '%c'.\n", choice->row,
+                choice->column, color_table[i]);
+      } else {
+        fprintf(fd, "Grid[%ld][%ld]'s choice is '%zu'.\n", choice->row,
+                choice->column, i + 1);
+      }
       return;
     }
   }
@@ -663,84 +2279,330 @@ choice_t *grid_choice(grid_t *grid) {
   return NULL;
 }
 
-grid_t *get_new_grid(const size_t size) {
+/* Naked and hidden subsets, rated as a single technique */
+static bool subsets(colors_t *subgrid[], size_t size) {
+
+  bool changed = naked_subset(subgrid, size);
+  changed |= hidden_subset(subgrid, size);
+
+  return changed;
+}
+
+/* Apply locked candidates, pointing and claiming, on `grid` */
+static bool grid_locked_candidates(grid_t *grid, units_t *units) {
+
+  uint64_t dirty[UNITS_WORDS] = {0};
+  bool changed = grid_intersections(grid, units, dirty);
+
+  if (units->is_consistent && !units_matching(grid, dirty)) {
+    units->is_consistent = false;
+  }
+
+  return changed;
+}
+
+/* Apply the logical techniques up to `limit`, always retrying the easiest ones
+ * first after a change. Return the grid_heuristics() status codes. */
+static size_t grid_rate_logic(grid_t *grid, rating_t *rating,
+                              const technique_t limit) {
+
+  bool (*unit_techniques[])(colors_t *[], size_t) = {cross_hatching,
+                                                      lone_number, subsets};
+  size_t technique = technique_cross_hatching;
+  uint8_t counts[3 * grid->size * grid->size];
+  units_t units;
+
+  /* The guesses are not propagated, the grid is checked once on entry and
+   * the eliminations are counted from there */
+  if (!grid_is_consistent(grid)) {
+    return status_code_grid_is_inconsistent;
+  }
+  units_init(&units, grid, counts);
+
+  while (technique < technique_guess) {
+
+    bool changed =
+        (technique == technique_locked_candidates)
+            ? grid_locked_candidates(grid, &units)
+            : grid_units_heuristic(grid, unit_techniques[technique], &units);
+
+    if (!units.is_consistent) {
+      return status_code_grid_is_inconsistent;
+    }
+
+    if (!changed) {
+      technique++;
+      continue;
+    }
+
+    if (technique > rating->hardest) {
+      rating->hardest = technique;
+    }
+
+    if (technique > limit) {
+      return status_code_grid_is_not_solved_and_consistent;
+    }
+
+    technique = technique_cross_hatching;
+  }
+
+  return grid_is_solved(grid) ? status_code_grid_is_solved
+                              : status_code_grid_is_not_solved_and_consistent;
+}
+
+/* Rate `grid`, guessing when the logic is stuck */
+static size_t grid_rate_rec(grid_t *grid, rating_t *rating,
+                            const technique_t limit) {
+
+  size_t res = grid_rate_logic(grid, rating, limit);
+
+  if (res != status_code_grid_is_not_solved_and_consistent ||
+      rating->hardest > limit) {
+    return res;
+  }
+
+  rating->hardest = technique_guess;
+  if (technique_guess > limit) {
+    return res;
+  }
+
+  choice_t *choice = grid_choice(grid);
+  grid_t *grid_cpy = grid_copy(grid);
+  if (choice == NULL || grid_cpy == NULL) {
+    grid_choice_free(choice);
+    grid_free(grid_cpy);
+    return status_code_grid_is_inconsistent;
+  }
+
+  rating->nb_guesses++;
+  grid_choice_apply(grid_cpy, choice);
+  res = grid_rate_rec(grid_cpy, rating, limit);
+
+  if (res == status_code_grid_is_solved) {
+    grid_deep_copy(grid, grid_cpy);
+  } else {
+    grid_choice_discard(grid, choice);
+    res = grid_rate_rec(grid, rating, limit);
+  }
+
+  grid_free(grid_cpy);
+  grid_choice_free(choice);
+
+  return res;
+}
+
+size_t grid_rate(grid_t *grid, rating_t *rating, const technique_t limit) {
+
+  rating->hardest = technique_cross_hatching;
+  rating->nb_guesses = 0;
+
+  return grid_rate_rec(grid, rating, limit);
+}
+
+grid_t *get_new_grid(const size_t size, prng_t *prng) {
 
   grid_t *grid = grid_alloc(size);
-  grid->size = size;
   colors_t all_colors = colors_full(size);
 
-  if (!seed_intialized) {
-    srand(time(NULL));
-    seed_intialized = true;
+  /* A random permutation on the first row is always completable */
+  colors_t remaining_colors = all_colors;
+  for (size_t j = 0; j < size; j++) {
+    cell_write(grid, j, colors_random(remaining_colors, prng));
+    remaining_colors = colors_subtract(remaining_colors, grid->cells[0][j]);
   }
 
-  for (size_t i = 0; i < size; i++) {
-    for (size_t j = 0; j < size; j++) {
+  return grid;
+}
 
-      grid->cells[i][j] = all_colors;
+/* Fill `order` with a random permutation of the `n` groups of `n` items,
+ * each group being shuffled within itself, as the rows of the bands */
+static void shuffle_groups(size_t *order, const size_t n, prng_t *prng) {
+
+  size_t groups[n];
+  size_t items[n];
+
+  for (size_t i = 0; i < n; i++) {
+    groups[i] = i;
+  }
+  for (size_t i = n - 1; i > 0; i--) {
+    size_t j = prng_bounded(prng, i + 1);
+    size_t tmp = groups[i];
+    groups[i] = groups[j];
+    groups[j] = tmp;
+  }
+
+  for (size_t group = 0; group < n; group++) {
+    for (size_t i = 0; i < n; i++) {
+      items[i] = i;
+    }
+    for (size_t i = n - 1; i > 0; i--) {
+      size_t j = prng_bounded(prng, i + 1);
+      size_t tmp = items[i];
+      items[i] = items[j];
+      items[j] = tmp;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      order[group * n + i] = groups[group] * n + items[i];
     }
   }
+}
+
+grid_t *get_new_solved_grid(const size_t size, prng_t *prng) {
+
+  grid_t *grid = grid_alloc(size);
+  if (grid == NULL) {
+    return NULL;
+  }
+
+  size_t n = get_sqrt(size);
+  size_t rows[size];
+  size_t columns[size];
+  size_t colors[size];
+
+  shuffle_groups(rows, n, prng);
+  shuffle_groups(columns, n, prng);
+  for (size_t i = 0; i < size; i++) {
+    colors[i] = i;
+  }
+  for (size_t i = size - 1; i > 0; i--) {
+    size_t j = prng_bounded(prng, i + 1);
+    size_t tmp = colors[i];
+    colors[i] = colors[j];
+    colors[j] = tmp;
+  }
 
-  size_t index_i = rand() % size;
-  size_t index_j = (index_i * 2) % size;
-  colors_t random = colors_set(index_i);
-  grid->cells[index_i][index_j] = random;
+  for (size_t row = 0; row < size; row++) {
+    size_t pattern_row = rows[row] % n * n + rows[row] / n;
+
+    for (size_t column = 0; column < size; column++) {
+      size_t color_id = colors[(pattern_row + columns[column]) % size];
+      cell_write(grid, row * size + column, colors_set(color_id));
+    }
+  }
 
   return grid;
 }
 
-void remove_some_colors(grid_t *grid, size_t nb_colors_to_remove) {
+void remove_some_colors(grid_t *grid, size_t nb_colors_to_remove,
+                        prng_t *prng) {
 
   size_t size = grid->size;
   size_t nb_colors_to_remove_per_line = ceil(nb_colors_to_remove / size);
   colors_t full_colors = colors_full(size);
 
-  if (!seed_intialized) {
-    srand(time(NULL));
-    seed_intialized = true;
-  }
-
   for (size_t i = 0; i < size; i++) {
 
     for (size_t j = 0; j < nb_colors_to_remove_per_line; j++) {
-      size_t index = rand() % size;
-      grid->cells[i][index] = full_colors;
+      size_t index = prng_bounded(prng, size);
+      cell_write(grid, i * size + index, full_colors);
     }
   }
 }
 
-choice_t *remove_one_color(grid_t *grid, int *tab, size_t tab_size) {
+removal_t *grid_removal_alloc(const grid_t *grid, prng_t *prng) {
+
+  removal_t *removal = malloc(sizeof(removal_t));
+  if (removal == NULL) {
+    return NULL;
+  }
+
+  size_t nb_cells = grid->size * grid->size;
+  size_t nb_words = (nb_cells + 63) / 64;
+
+  removal->size = grid->size;
+  removal->nb_cells = nb_cells;
+  removal->next = 0;
+  removal->order = malloc(nb_cells * sizeof(uint32_t));
+  removal->excluded = calloc(nb_words, sizeof(uint64_t));
+  removal->removed = calloc(nb_words, sizeof(uint64_t));
 
-  bool is_finished = false;
-  choice_t *choice = malloc(sizeof(choice_t));
-  if (choice == NULL) {
+  if (removal->order == NULL || removal->excluded == NULL ||
+      removal->removed == NULL) {
+    grid_removal_free(removal);
     return NULL;
   }
-  if (!seed_intialized) {
-    srand(time(NULL));
-    seed_intialized = true;
+
+  /* Fisher-Yates shuffle of all the cells */
+  for (size_t i = 0; i < nb_cells; i++) {
+    removal->order[i] = i;
   }
-  size_t row = 0;
-  size_t column = 0;
-  while (!is_finished) {
-    row = rand() % grid->size;
-    column = rand() % grid->size;
-    int tmp = row * 10 + column;
-    bool is_in_tab = false;
 
-    for (size_t i = 0; i < tab_size; i++) {
-      if (tab[i] == tmp) {
-        is_in_tab = true;
-        break;
-      }
+  for (size_t i = nb_cells - 1; i > 0; i--) {
+    size_t j = prng_bounded(prng, i + 1);
+    uint32_t tmp = removal->order[i];
+    removal->order[i] = removal->order[j];
+    removal->order[j] = tmp;
+  }
+
+  return removal;
+}
+
+void grid_removal_free(removal_t *removal) {
+
+  if (removal == NULL) {
+    return;
+  }
+
+  free(removal->order);
+  free(removal->excluded);
+  free(removal->removed);
+  free(removal);
+}
+
+choice_t *grid_removal_next(removal_t *removal, grid_t *grid) {
+
+  size_t size = removal->size;
+
+  while (removal->next < removal->nb_cells) {
+    size_t cell = removal->order[removal->next];
+    size_t row = cell / size;
+    size_t column = cell % size;
+    removal->next++;
+
+    if (bitset_is_in(removal->excluded, cell) ||
+        bitset_is_in(removal->removed, cell) ||
+        !colors_is_singleton(grid->cells[row][column])) {
+      continue;
+    }
+
+    choice_t *choice = malloc(sizeof(choice_t));
+    if (choice == NULL) {
+      return NULL;
     }
 
-    is_finished = !is_in_tab && colors_is_singleton(grid->cells[row][column]);
+    choice->row = row;
+    choice->column = column;
+    choice->color = grid->cells[row][column];
+
+    cell_write(grid, cell, colors_full(size));
+    bitset_add(removal->removed, cell);
+
+    return choice;
   }
 
-  choice->row = row;
-  choice->column = column;
-  choice->color = grid->cells[row][column];
-  grid->cells[row][column] = colors_full(grid->size);
-  return choice;
-}
\ No newline at end of file
+  return NULL;
+}
+
+void grid_removal_restore(removal_t *removal, grid_t *grid,
+                          const choice_t *choice) {
+
+  size_t cell = choice->row * removal->size + choice->column;
+
+  cell_write(grid, cell, choice->color);
+  bitset_discard(removal->removed, cell);
+  bitset_add(removal->excluded, cell);
+}
+
+void grid_removal_retry(removal_t *removal, grid_t *grid,
+                        const choice_t *choice) {
+
+  size_t cell = choice->row * removal->size + choice->column;
+
+  cell_write(grid, cell, choice->color);
+  bitset_discard(removal->removed, cell);
+
+  /* Slots before `next` have already been consumed and can be reused */
+  removal->next--;
+  removal->order[removal->next] = cell;
+}
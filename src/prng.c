@@ -0,0 +1,62 @@
+#include "prng.h"
+
+/* Step of the splitmix64 generator, only used to expand the seeds */
+static uint64_t splitmix64(uint64_t *x) {
+
+  uint64_t z = (*x += 0x9E3779B97F4A7C15);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+
+  return z ^ (z >> 31);
+}
+
+static uint64_t rotl(const uint64_t x, const int k) {
+
+  return (x << k) | (x >> (64 - k));
+}
+
+void prng_seed(prng_t *prng, const uint64_t seed, const uint64_t stream) {
+
+  /* Each (seed, stream) pair is hashed into its own starting point, so that
+   * puzzles generated on different streams are uncorrelated */
+  uint64_t x = seed;
+  uint64_t mix = splitmix64(&x) ^ stream;
+  x = mix;
+
+  for (size_t i = 0; i < 4; i++) {
+    prng->state[i] = splitmix64(&x);
+  }
+}
+
+uint64_t prng_next(prng_t *prng) {
+
+  uint64_t *s = prng->state;
+  const uint64_t result = rotl(s[1] * 5, 7) * 9;
+  const uint64_t t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+
+  return result;
+}
+
+size_t prng_bounded(prng_t *prng, const size_t bound) {
+
+  if (bound == 0) {
+    return 0;
+  }
+
+  /* Draws below `threshold` would make the lowest values more likely */
+  const uint64_t threshold = -(uint64_t)bound % bound;
+  uint64_t x;
+
+  do {
+    x = prng_next(prng);
+  } while (x < threshold);
+
+  return (size_t)(x % bound);
+}
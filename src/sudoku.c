@@ -1,6 +1,8 @@
 #include "sudoku.h"
 
 #include "grid.c"
+#include "bitboard.h"
+#include "tt.h"
 
 #include <stdbool.h>
 #include <stdio.h>
@@ -9,14 +11,116 @@
 
 #include <assert.h>
 #include <err.h>
+#include <errno.h>
 #include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
 
 #define GRID_DEFAULT_SIZE 9
 #define EMPTY_CELLS_RATE 0.4
+#define PATTERN_EMPTY_CELLS_RATE 0.3 /* Above 64x64, keeps the solving short */
+#define GRIDS_PER_THREAD_AND_CHUNK 64
+#define MAX_THREADS 1024
+#define MAX_DIFFICULTY 5
+#define MAX_DIFFICULTY_ATTEMPTS 1000
+#define MAX_SEARCHED_GENERATOR_SIZE 64 /* Larger grids come from a pattern */
+#define DEFAULT_TT_MEGABYTES 0 /* The table is off unless --tt-mb */
+#define DEFAULT_CHECKPOINT_INTERVAL 600
+#define CHECKPOINT_VERSION 2
+#define SNAPSHOTS_CHUNK 16
+#define MAX_NOGOOD_SIZE 16
+#define DEFAULT_NOGOODS 256
+#define DEFAULT_PROGRESS_INTERVAL 5
+#define PROGRESS_PROBE_SHARE 0.02 /* Of the time, spent on the estimates */
+#define SOLUTIONS_REPORT "# Number of solutions: "
+
+/* Values returned by getopt_long() for options without a short form */
+enum {
+  option_subset_order = 256,
+  option_fish,
+  option_finned,
+  option_chains,
+  option_chain_budget,
+  option_probe,
+  option_all_different,
+  option_backjump,
+  option_nogoods,
+  option_tt_mb,
+  option_factor,
+  option_count,
+  option_limit,
+  option_checkpoint,
+  option_checkpoint_interval,
+  option_resume,
+  option_split_depth,
+  option_emit_shards,
+  option_solve_shard,
+  option_merge,
+  option_progress,
+  option_bitboard,
+  option_schedule
+};
 
 static bool verbose = false;
-static size_t count_solved_grid = 0;
+static uint64_t count_solved_grid = 0;
+static uint64_t solution_limit = 0; /* The solver stops there, 0 for never */
+static tt_t *solver_tt = NULL; /* Solution counts of the explored states */
+static const char *checkpoint_file = NULL;
+static size_t checkpoint_interval = DEFAULT_CHECKPOINT_INTERVAL; /* Seconds */
+static volatile sig_atomic_t checkpoint_signal = 0;
+static size_t progress_interval = 0; /* Seconds, 0 for no progress */
+static bool use_bitboard = false;
+
+/* Options of the solver saved in the checkpoints, a resumed search goes on
+ * with the options it started with */
+typedef struct {
+  mode_t mode;
+  uint64_t limit; /* Number of solutions stopping the solver, 0 for never */
+  size_t probe;
+  size_t subset_order;
+  bool all_different;
+  size_t fish;
+  bool finned;
+  size_t chains;
+  double chain_budget;
+  schedule_t schedule;
+  bool backjump;
+} solver_options_t;
+
+static const solver_options_t default_solver_options = {
+    .mode = mode_first,
+    .limit = 0,
+    .probe = 0,
+    .subset_order = DEFAULT_SUBSET_ORDER,
+    .all_different = false,
+    .fish = DEFAULT_FISH_ORDER,
+    .finned = false,
+    .chains = DEFAULT_CHAIN_LENGTH,
+    .chain_budget = DEFAULT_CHAIN_BUDGET,
+    .schedule = schedule_full,
+    .backjump = false};
+
+static solver_options_t solver_options;
+
+static const char *mode_names[] = {"first", "all", "count"};
+static const char *schedule_names[] = {"full", "adaptive"};
+
+/* Set the heuristics and the limit of the solver from `options` */
+static void solver_options_apply(const solver_options_t *options) {
+
+  solution_limit = options->limit;
+  grid_set_probe(options->probe);
+  subset_set_max_order(options->subset_order);
+  all_different_set_enabled(options->all_different);
+  grid_set_fish(options->fish, options->finned);
+  grid_set_chains(options->chains, options->chain_budget);
+  grid_set_schedule(options->schedule);
+}
 
 /* Return a grid structure that contains the first row of input grid */
 static grid_t *write_first_row_to_grid(char *first_row, int grid_size) {
@@ -25,7 +129,7 @@ static grid_t *write_first_row_to_grid(char *first_row, int grid_size) {
 
   if (!grid_check_size(grid_size)) {
     warnx("error: invalid grid size '%d'.\n"
-          "Possible sizes: 1, 4, 9, 16, 25, 36, 49, 64.\n",
+          "Possible sizes: " GRID_SIZES ".\n",
           grid_size);
 
     return NULL;
@@ -49,6 +153,145 @@ static grid_t *write_first_row_to_grid(char *first_row, int grid_size) {
   return grid;
 }
 
+/* Return the number of blank separated words on the first line of the grid
+ * in `filename`, comments left aside */
+static size_t file_first_row_words(const char *filename) {
+
+  FILE *file = fopen(filename, "r");
+  if (file == NULL) {
+    errx(EXIT_FAILURE, "error: Error while opening file %s", filename);
+  }
+
+  int c;
+  size_t nb_words = 0;
+  bool is_comment_line = false;
+  bool in_word = false;
+
+  while ((c = fgetc(file)) != EOF) {
+    if (c == '\n') {
+      if (nb_words > 0) {
+        break;
+      }
+      is_comment_line = false;
+    } else if (c == '#') {
+      is_comment_line = true;
+    }
+
+    bool is_blank = is_comment_line || c == ' ' || c == '\t' || c == '\r' ||
+                    c == '\n';
+    if (!is_blank && !in_word) {
+      nb_words++;
+    }
+    in_word = !is_blank;
+  }
+  fclose(file);
+
+  return nb_words;
+}
+
+/* Parser of the grids above MAX_CHAR_GRID_SIZE, whose cells are numbers from
+ * 1 to the size of the grid, or '_', separated by blanks. Return NULL if the
+ * grid in `filename` is not valid. */
+static grid_t *file_parser_numbers(const char *filename, const size_t size) {
+
+  grid_t *grid = grid_alloc(size);
+  if (grid == NULL) {
+    warnx("error: invalid grid size '%zu'.\n"
+          "Possible sizes: " GRID_SIZES ".\n",
+          size);
+    return NULL;
+  }
+
+  FILE *file = fopen(filename, "r");
+  if (file == NULL) {
+    errx(EXIT_FAILURE, "error: Error while opening file %s", filename);
+  }
+
+  char word[8];
+  size_t length = 0;
+  size_t row = 0;
+  size_t column = 0;
+  bool is_comment_line = false;
+  int c;
+
+  do {
+    c = fgetc(file);
+
+    if (c == '#') {
+      is_comment_line = true;
+    }
+
+    bool is_blank = is_comment_line || c == EOF || c == ' ' || c == '\t' ||
+                    c == '\r' || c == '\n';
+    if (!is_blank) {
+      if (length + 1 == sizeof(word)) {
+        warnx("error: wrong cell at line %zu column %zu!\n", row + 1,
+              column + 1);
+        goto invalid;
+      }
+      word[length++] = c;
+      continue;
+    }
+
+    if (length > 0) {
+      char *end;
+      word[length] = '\0';
+      length = 0;
+
+      if (row >= size) {
+        warnx("error: grid has line(s) more than expected.\n");
+        goto invalid;
+      }
+      if (column >= size) {
+        warnx("error: line %zu has column(s) more than expected.\n", row + 1);
+        goto invalid;
+      }
+
+      unsigned long number = strtoul(word, &end, 10);
+      if (strcmp(word, "_") == 0) {
+        cell_write(grid, row * size + column++, colors_full(size));
+      } else if (*end == '\0' && word[0] != '-' && number >= 1 &&
+                 number <= size) {
+        cell_write(grid, row * size + column++, colors_set(number - 1));
+      } else {
+        warnx("error: wrong cell '%s' at line %zu column %zu!\n", word,
+              row + 1, column + 1);
+        goto invalid;
+      }
+    }
+
+    if (c == '\n' || c == EOF) {
+      is_comment_line = false;
+
+      if (column > 0) {
+        if (column < size) {
+          warnx("error: line %zu is malformed! "
+                "Grid has %zu missing column(s)\n",
+                row + 1, size - column);
+          goto invalid;
+        }
+        row++;
+        column = 0;
+      }
+    }
+  } while (c != EOF);
+
+  fclose(file);
+
+  if (row != size) {
+    warnx("error: grid has %zu missing line(s)", size - row);
+    grid_free(grid);
+    return NULL;
+  }
+
+  return grid;
+
+invalid:
+  fclose(file);
+  grid_free(grid);
+  return NULL;
+}
+
 /**
  * This parser returns:
  *  + a pointer to the grid if it's a valid grid in the file `filename`.
@@ -56,6 +299,11 @@ static grid_t *write_first_row_to_grid(char *first_row, int grid_size) {
  */
 static grid_t *file_parser(char *filename) {
 
+  size_t nb_words = file_first_row_words(filename);
+  if (nb_words > MAX_CHAR_GRID_SIZE) {
+    return file_parser_numbers(filename, nb_words);
+  }
+
   FILE *file = fopen(filename, "r");
   if (file == NULL) {
     errx(EXIT_FAILURE, "error: Error while opening file %s", filename);
@@ -63,7 +311,7 @@ static grid_t *file_parser(char *filename) {
 
   int c;
   grid_t *grid = NULL;
-  char first_row[MAX_GRID_SIZE];
+  char first_row[MAX_CHAR_GRID_SIZE];
 
   bool is_comment_line = false;
   bool first_row_readed = false;
@@ -127,6 +375,11 @@ static grid_t *file_parser(char *filename) {
         }
 
         if (!first_row_readed) {
+          if (grid_size == MAX_CHAR_GRID_SIZE) {
+            warnx("error: invalid grid size, more than %d columns.\n",
+                  MAX_CHAR_GRID_SIZE);
+            return NULL;
+          }
           first_row[grid_size] = c;
           grid_size++;
           break;
@@ -192,325 +445,2967 @@ static grid_t *file_parser(char *filename) {
   return grid;
 }
 
-/**
- * Return:
- * + 0: if the grid is not solved but still consistent
- * + 1: if the grid is solved and display it
- * + 2: if the grid is inconsistent
- */
-static size_t grid_solver(grid_t *grid, const mode_t mode, FILE *fd) {
+/* Display the `number`-th solution found by the solver, unless only the
+ * solutions are counted */
+static void solution_print(const grid_t *grid, const mode_t mode,
+                           const uint64_t number, FILE *fd) {
 
-  grid_t *grid_cpy;
-  choice_t *choice;
+  if (mode == mode_count) {
+    return;
+  }
 
-  size_t res = grid_heuristics(grid, true);
+  fflush(fd);
 
-  switch (res) {
+  if (mode == mode_all) {
+    fprintf(fd, "Solution %" PRIu64 "\n", number);
+  } else {
+    fprintf(fd, "Solution\n");
+  }
+  grid_print(grid, fd);
+}
 
-  case 1:
-    count_solved_grid++;
-    fflush(fd);
+/* Decision of the search: a color chosen for a cell, or discarded from it */
+typedef struct {
+  size_t row;
+  size_t column;
+  colors_t color;
+  bool positive;
+} decision_t;
+
+/* Frame of the search stack, one per decision of the current path */
+typedef struct {
+  decision_t decision; /* Positive while the first branch is explored */
+  grid_hash_t hash;    /* Of the node, for the transposition table */
+  uint64_t solutions_before;
+} frame_t;
+
+/* Progress reports of a search, with Knuth estimates of the tree size */
+typedef struct {
+  double start; /* Seconds, on a monotonic clock */
+  double next_report;
+  grid_t *probe; /* Grids of the random paths of the estimates */
+  grid_t *sibling;
+  prng_t prng;
+  double sum_estimates;
+  size_t nb_estimates;
+  double probe_time; /* Seconds spent on the estimates */
+} progress_t;
+
+/* Iterative search engine shared by the solver and the generator. A path
+ * holds at most one positive decision per cell and each decision removes at
+ * least one color, so `size^3` frames and `size^2` snapshots are enough. The
+ * snapshots are packed by grid_pack() one after the other in a single
+ * buffer, so that the stack of a 9x9 search fits in a few KB. */
+typedef struct backjump_t backjump_t;
+typedef struct search_t search_t;
+struct search_t {
+  grid_t *grid; /* Grid being searched, holds the last solution found */
+  frame_t *frames;
+  size_t depth;
+  size_t max_depth;
+  unsigned char *snapshots; /* Grids before the choices of first branches */
+  size_t snapshot_bytes;
+  size_t nb_snapshots;
+  size_t allocated_snapshots;
+  size_t max_snapshots;
+  bool use_locked_candidates;
+  bool use_probe;
+  tt_t *tt;           /* Transposition table, NULL for none */
+  bool reuse_counts;  /* Solutions counts of the table stand for the solutions */
+  uint64_t limit;     /* Number of solutions stopping the search, 0 for none */
+  uint64_t nb_solutions;
+  void (*on_solution)(search_t *search);
+  void *data;
+  grid_t *root;           /* Grid before any decision, for the checkpoints */
+  const char *checkpoint; /* File where the stack is saved, NULL for none */
+  time_t next_checkpoint;
+  uint64_t nb_nodes;    /* Branches entered by the search */
+  progress_t *progress; /* NULL for no progress reports */
+  bitboard_t *bitboard; /* Propagates the root first, NULL for none */
+  colors_t *bitboard_cells; /* Colors stored back from the bitboard */
+  backjump_t *backjump;     /* Runs the search instead, NULL for none */
+};
+
+/* Seconds elapsed on a monotonic clock */
+static double progress_now(void) {
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
 
-    if (mode == mode_all) {
-      fprintf(fd, "Solution %lu\n", count_solved_grid);
-    } else {
-      fprintf(fd, "Solution\n");
-    }
-    grid_print(grid, fd);
-    // FALL THROUGH
+static progress_t *progress_alloc(const grid_t *root) {
 
-  case 2:
-    return res;
+  progress_t *progress = malloc(sizeof(progress_t));
+  if (progress == NULL) {
+    return NULL;
+  }
 
-  case 0:
+  progress->probe = grid_copy(root);
+  progress->sibling = grid_copy(root);
+  if (progress->probe == NULL || progress->sibling == NULL) {
+    grid_free(progress->probe);
+    grid_free(progress->sibling);
+    free(progress);
+    return NULL;
+  }
 
-    grid_cpy = grid_copy(grid);
-    if (grid_cpy == NULL) {
-      errx(EXIT_FAILURE, "error: Error while doing a deep code of grid\n");
-    }
+  progress->start = progress_now();
+  progress->next_report = progress->start + (double)progress_interval;
+  progress->sum_estimates = 0;
+  progress->nb_estimates = 0;
+  progress->probe_time = 0;
+  prng_seed(&progress->prng, 0, 0);
 
-    choice = grid_choice(grid_cpy);
-    assert(choice != NULL);
+  return progress;
+}
 
-    grid_choice_apply(grid_cpy, choice);
-    size_t backtracking_res = grid_solver(grid_cpy, mode, fd);
-    grid_free(grid_cpy);
+static void progress_free(progress_t *progress) {
 
-    if (backtracking_res == 1 && mode == mode_first) {
-      grid_choice_free(choice);
-      return 1;
-    }
+  if (progress == NULL) {
+    return;
+  }
 
-    grid_choice_discard(grid, choice);
-    grid_choice_free(choice);
+  grid_free(progress->probe);
+  grid_free(progress->sibling);
+  free(progress);
+}
+
+/* Prepare `search` on `grid` with the default settings of the generator, the
+ * frames are allocated up to their bound and the snapshots as they are
+ * needed */
+static void search_init(search_t *search, grid_t *grid) {
+
+  size_t size = grid_get_size(grid);
 
-    return grid_solver(grid, mode, fd);
+  *search = (search_t){.grid = grid,
+                       .frames = malloc(size * size * size * sizeof(frame_t)),
+                       .max_depth = size * size * size,
+                       .snapshot_bytes = size * size * grid_cell_bytes(size),
+                       .max_snapshots = size * size};
 
-  default:
-    return res;
+  if (search->frames == NULL) {
+    errx(EXIT_FAILURE, "error: Error while allocating the search stack\n");
   }
 }
 
-/**
- * Return:
- * + 0: if the grid is not solved but still consistent
- * + 1: if the grid is solved and display it
- * + 2: if the grid is inconsistent
- */
-static size_t grid_solver_for_generator(grid_t *grid, const generator_t mode) {
+static void search_release(search_t *search) {
 
-  grid_t *grid_cpy;
-  choice_t *choice;
-  size_t res = grid_heuristics(grid, false);
+  free(search->snapshots);
+  free(search->frames);
+  grid_free(search->root);
+  progress_free(search->progress);
+  bitboard_free(search->bitboard);
+  free(search->bitboard_cells);
+}
 
-  switch (res) {
+/* Return True once the search found as many solutions as it was asked */
+static bool search_is_finished(const search_t *search) {
 
-  case 1:
-    count_solved_grid++;
-    // FALL THROUGH
+  return search->limit != 0 && search->nb_solutions >= search->limit;
+}
 
-  case 2:
-    return res;
+/* Push a packed copy of the grid on the snapshots, growing them by half */
+static void search_save(search_t *search) {
 
-  case 0:
+  assert(search->nb_snapshots < search->max_snapshots);
 
-    grid_cpy = grid_copy(grid);
-    if (grid_cpy == NULL) {
-      errx(EXIT_FAILURE, "error: Error while doing a deep code of grid\n");
+  if (search->nb_snapshots == search->allocated_snapshots) {
+    size_t allocated = search->allocated_snapshots +
+                       search->allocated_snapshots / 2 + SNAPSHOTS_CHUNK;
+    if (allocated > search->max_snapshots) {
+      allocated = search->max_snapshots;
     }
 
-    choice = grid_choice(grid_cpy);
-    assert(choice != NULL);
+    unsigned char *snapshots =
+        realloc(search->snapshots, allocated * search->snapshot_bytes);
+    if (snapshots == NULL) {
+      errx(EXIT_FAILURE, "error: Error while allocating the search stack\n");
+    }
+    search->snapshots = snapshots;
+    search->allocated_snapshots = allocated;
+  }
 
-    grid_choice_apply(grid_cpy, choice);
-    size_t backtracking_res = grid_solver_for_generator(grid_cpy, mode);
+  grid_pack(search->grid, search->snapshots + search->nb_snapshots++ *
+                                                  search->snapshot_bytes);
+}
 
-    if (backtracking_res == 1) {
-      bool is_finished = false;
+/* Save the grid and go down the first branch of its choice */
+static void search_push(search_t *search, const grid_hash_t hash) {
 
-      if (mode == mode_not_unique) {
-        is_finished = true;
-      } else if ((mode == mode_unique) && count_solved_grid >= 2) {
-        is_finished = true;
-      }
+  grid_t *grid = search->grid;
 
-      if (is_finished) {
-        grid_deep_copy(grid, grid_cpy);
-        grid_free(grid_cpy);
-        grid_choice_free(choice);
-        return backtracking_res;
-      }
-    }
+  assert(search->depth < search->max_depth);
 
-    grid_free(grid_cpy);
-    grid_choice_discard(grid, choice);
-    grid_choice_free(choice);
+  search_save(search);
 
-    return grid_solver_for_generator(grid, mode);
+  choice_t *choice = grid_choice(grid);
+  assert(choice != NULL);
 
-  default:
-    return res;
-  }
+  search->frames[search->depth++] =
+      (frame_t){.decision = {.row = choice->row,
+                             .column = choice->column,
+                             .color = choice->color,
+                             .positive = true},
+                .hash = hash,
+                .solutions_before = search->nb_solutions};
+  search->nb_nodes++;
+
+  /* An emptied cell is found by the propagation that follows */
+  grid_choice_assign(grid, choice);
+  grid_choice_free(choice);
 }
 
-/* Generate a grid of specified size */
-static grid_t *grid_generator(const bool is_unique_mode, const size_t size) {
+/* Go to the next branch left on the stack, return False if there is none */
+static bool search_backtrack(search_t *search) {
 
-  grid_t *grid = get_new_grid(size);
-  generator_t mode = is_unique_mode ? mode_unique : mode_not_unique;
-  grid_solver_for_generator(grid, mode);
+  while (search->depth > 0) {
+    frame_t *frame = &search->frames[search->depth - 1];
 
-  if (!is_unique_mode) {
-    size_t nb_colors_to_remove = ceil(size * size * EMPTY_CELLS_RATE);
-    remove_some_colors(grid, nb_colors_to_remove);
-  } else {
+    if (frame->decision.positive) {
+      /* The second branch starts from the grid before the choice */
+      choice_t choice = {.row = frame->decision.row,
+                         .column = frame->decision.column,
+                         .color = frame->decision.color};
 
-    int tab[grid->size]; /* Contains index of cells from which colors must not
-                            be removed */
-    size_t index = 0;
-    size_t nb_color_removed = 0;
-    size_t nb_color_to_remove = grid->size * grid->size * EMPTY_CELLS_RATE;
+      grid_unpack(search->grid, search->snapshots + --search->nb_snapshots *
+                                                        search->snapshot_bytes);
+      grid_choice_discard(search->grid, &choice);
+      frame->decision.positive = false;
+      search->nb_nodes++;
 
-    while (nb_color_removed < nb_color_to_remove) {
+      return true;
+    }
 
-      choice_t *choice = remove_one_color(grid, tab, index);
-      grid_t *grid_cpy = grid_copy(grid);
-      if (grid_cpy == NULL) {
-        errx(EXIT_FAILURE, "error: Error while doing a deep code of grid\n");
-      }
+    /* Both branches are explored */
+    if (search->tt != NULL) {
+      tt_store(search->tt, frame->hash.key, frame->hash.check,
+               search->nb_solutions - frame->solutions_before);
+    }
+    search->depth--;
+  }
 
-      count_solved_grid = 0;
-      grid_solver_for_generator(grid_cpy, mode);
+  return false;
+}
 
-      if (count_solved_grid == 1) {
-        nb_color_removed++;
+/* Ask the search to save its stack and stop */
+static void checkpoint_on_signal(int signal_number) {
 
-      } else {
-        grid->cells[choice->row][choice->column] = choice->color;
-        tab[index] = choice->column + 10 * choice->row;
-        index++;
+  checkpoint_signal = signal_number;
+}
 
-        nb_color_removed--;
-      }
-      grid_choice_free(choice);
-      grid_free(grid_cpy);
-    }
+/* Write colors in hexadecimal, in the wide build the high word comes first,
+ * before a colon, when it is not zero */
+static void checkpoint_write_colors(FILE *fd, const colors_t colors) {
+
+#ifdef COLORS_WIDE
+  uint64_t high = colors >> 64;
+  if (high != 0) {
+    fprintf(fd, "%" PRIx64 ":%016" PRIx64, high, (uint64_t)colors);
+    return;
   }
+#endif
 
-  return grid;
+  fprintf(fd, "%" PRIx64, (uint64_t)colors);
 }
 
-int main(int argc, char *argv[]) {
+/* Read colors written by checkpoint_write_colors(), return False if they are
+ * not valid */
+static bool checkpoint_read_colors(FILE *fd, colors_t *colors) {
 
-  const char *help_msg =
-      "Usage:  sudoku [-a| -o FILE| -v| -V| -h] FILE...\n"
-      "\tsudoku -g[SIZE] [-u| -o FILE| -v| -V| -h]\n"
-      "Solve or generate Sudoku grids of various sizes "
-      "(1, 4, 9, 16, 25, 36, 49, 64)\n\n"
-      "-a, -all\t\t search for all possible solutions\n"
-      "-g[N], --generate[=N]\t generate a grid of size N*N "
-      "(default:9)\n"
-      "-u, --unique\t\t generate a grid with unique solution\n"
-      "-o FILE, --output FILE\t write solution to File\n"
-      "-v, --verbose\t\t verbose output\n"
-      "-V, --version\t\t display version and exit\n"
-      "-h, --help\t\t display this help and exit";
+  char word[40];
+  char *end;
 
-  bool unique = false;
-  bool all = false;
-  bool generate = false;
+  if (fscanf(fd, "%39s", word) != 1) {
+    return false;
+  }
 
-  int grid_size = GRID_DEFAULT_SIZE;
+  colors_t value = strtoull(word, &end, 16);
+#ifdef COLORS_WIDE
+  if (*end == ':') {
+    value = (value << 64) | strtoull(end + 1, &end, 16);
+  }
+#endif
+  *colors = value;
 
-  FILE *program_output = stdout;
-  char *output_file_name = NULL;
+  return end != word && *end == '\0';
+}
 
-  const struct option long_opts[] = {{"all", no_argument, NULL, 'a'},
-                                     {"generate", optional_argument, NULL, 'g'},
-                                     {"unique", no_argument, NULL, 'u'},
-                                     {"output", required_argument, NULL, 'o'},
-                                     {"verbose", no_argument, NULL, 'v'},
-                                     {"version", no_argument, NULL, 'V'},
-                                     {"help", no_argument, NULL, 'h'},
-                                     {NULL, no_argument, NULL, no_argument}};
+/**
+ * Write the stack of `search` in `file_name`: the options of the solver, the
+ * root grid, the decisions of the current path and the solutions found so
+ * far. The file is written aside then renamed, so that a crash leaves the
+ * previous checkpoint.
+ */
+static void checkpoint_write(const search_t *search, const char *file_name) {
+
+  size_t size = grid_get_size(search->root);
+  size_t length = strlen(file_name) + 5;
+  char *tmp_name = malloc(length);
+  if (tmp_name == NULL) {
+    errx(EXIT_FAILURE, "error: Error while writing checkpoint '%s'",
+         file_name);
+  }
+  snprintf(tmp_name, length, "%s.tmp", file_name);
 
-  int optc;
-  while ((optc = getopt_long(argc, argv, "ag::uo:vVh", long_opts, NULL)) !=
-         -1) {
+  FILE *fd = fopen(tmp_name, "w");
+  if (fd == NULL) {
+    errx(EXIT_FAILURE, "error: Error while writing checkpoint '%s'", tmp_name);
+  }
 
-    switch (optc) {
-    case 'h':
-      fputs(help_msg, stdout);
-      exit(EXIT_SUCCESS);
+  const solver_options_t *options = &solver_options;
+
+  fprintf(fd, "sudoku-checkpoint %d\n", CHECKPOINT_VERSION);
+  fprintf(fd, "size %zu\n", size);
+  fprintf(fd, "mode %s\n", mode_names[options->mode]);
+  fprintf(fd, "limit %" PRIu64 "\n", options->limit);
+  fprintf(fd, "probe %zu\n", options->probe);
+  fprintf(fd, "subset-order %zu\n", options->subset_order);
+  fprintf(fd, "all-different %d\n", options->all_different);
+  fprintf(fd, "fish %zu\n", options->fish);
+  fprintf(fd, "finned %d\n", options->finned);
+  fprintf(fd, "chains %zu\n", options->chains);
+  fprintf(fd, "chain-budget %.17g\n", options->chain_budget);
+  fprintf(fd, "schedule %s\n", schedule_names[options->schedule]);
+  fprintf(fd, "backjump %d\n", options->backjump);
+  fprintf(fd, "solutions %" PRIu64 "\n", search->nb_solutions);
+  fprintf(fd, "depth %zu\n", search->depth);
+
+  for (size_t i = 0; i < search->depth; i++) {
+    const frame_t *frame = &search->frames[i];
+
+    fprintf(fd, "%zu %zu %zu %d %" PRIu64 "\n", frame->decision.row,
+            frame->decision.column, colors_count(frame->decision.color - 1),
+            frame->decision.positive, frame->solutions_before);
+  }
 
-    case 'V':
-      fprintf(stdout, "sudoku %d.%d.%d\n", VERSION, SUBVERSION, REVISION);
-      fputs("Solve or generate sudoku grids "
-            "(possible sizes: 1, 4, 9, 16, 25, 36, 49, 64)\n",
-            stdout);
-      exit(EXIT_SUCCESS);
+  for (size_t row = 0; row < size; row++) {
+    for (size_t column = 0; column < size; column++) {
+      checkpoint_write_colors(fd, search->root->cells[row][column]);
+      fputc(column + 1 < size ? ' ' : '\n', fd);
+    }
+  }
 
-    case 'v':
-      verbose = true;
-      break;
+  if (fclose(fd) != 0 || rename(tmp_name, file_name) != 0) {
+    errx(EXIT_FAILURE, "error: Error while writing checkpoint '%s'",
+         file_name);
+  }
 
-    case 'o':
-      output_file_name = optarg;
+  free(tmp_name);
+}
 
-      break;
+/* Apply the heuristics of `search` on `grid`. At the root, the singles and
+ * locked candidates run on its bitboard first if it has one: below, the
+ * nodes change a few cells and the load and store of the whole grid would
+ * cost more than they save. */
+static size_t search_heuristics(const search_t *search, grid_t *grid) {
+
+  if (search->bitboard != NULL && search->depth == 0) {
+    bitboard_load(search->bitboard, grid->cells[0]);
+    if (bitboard_heuristics(search->bitboard,
+                            search->use_locked_candidates) ==
+        status_code_grid_is_inconsistent) {
+      return status_code_grid_is_inconsistent;
+    }
+    /* Only the cells it changed go back, with their hash */
+    bitboard_store(search->bitboard, search->bitboard_cells);
+    grid_set_colors(grid, search->bitboard_cells);
+  }
 
-    case 'a':
-      all = true;
-      break;
+  return grid_heuristics(grid, search->use_locked_candidates);
+}
 
-    case 'g':
-      generate = true;
+/* Propagate `grid` with the settings of `search`, as search_run() does
+ * before a choice, return the status of the grid */
+static size_t search_propagate(const search_t *search, grid_t *grid) {
 
-      if (optarg) {
-        grid_size = atoi(optarg);
+  size_t res;
 
-        if (!grid_check_size(grid_size)) {
-          errx(EXIT_FAILURE,
-               "error: invalid grid size '%d'. \n"
-               "Possible sizes: 1, 4, 9, 16, 25, 36, 49, 64.",
-               grid_size);
-        }
-      }
-      break;
+  do {
+    res = search_heuristics(search, grid);
+  } while (res == status_code_grid_is_not_solved_and_consistent &&
+           search->use_probe && grid_probe(grid));
 
-    case 'u':
-      unique = true;
-      break;
+  return res;
+}
 
-    default:
-      errx(EXIT_FAILURE, "error: invalid option '%s'\nCheck './sudoku -h' !",
-           argv[optind - 1]);
-    }
-  }
+#ifndef COLORS_WIDE
+/* Run the same command with sudoku-wide, installed next to this program, for
+ * the grids above 64x64. Never returns. */
+static void wide_exec(char *argv[]) {
 
-  if (output_file_name != NULL) {
-    program_output = fopen(output_file_name, "w+");
+  const char *slash = strrchr(argv[0], '/');
+
+  if (slash == NULL) {
+    execvp("sudoku-wide", argv);
+  } else {
+    size_t length = slash - argv[0] + 1;
+    char path[length + sizeof("sudoku-wide")];
+
+    memcpy(path, argv[0], length);
+    strcpy(path + length, "sudoku-wide");
+    execv(path, argv);
   }
 
-  if (program_output == NULL) {
-    errx(EXIT_FAILURE, "error: Error while opening file %s", optarg);
+  err(EXIT_FAILURE, "error: grids above 64x64 need sudoku-wide, built by make");
+}
+
+/* Return the size of the checkpoint `file_name`, 0 if it can not be read */
+static size_t checkpoint_size(const char *file_name) {
+
+  FILE *fd = fopen(file_name, "r");
+  if (fd == NULL) {
+    return 0;
   }
 
-  if (generate) {
-    fprintf(program_output, "# Generator mode \n");
+  int version;
+  size_t size = 0;
 
-    grid_t *grid = grid_generator(unique, grid_size);
-    grid_print(grid, program_output);
-    grid_free(grid);
-    return EXIT_SUCCESS;
+  if (fscanf(fd, "sudoku-checkpoint %d size %zu", &version, &size) != 2) {
+    size = 0;
   }
+  fclose(fd);
 
-  if (unique) {
-    unique = false;
-    warnx("warning: option 'unique' conflict with solver mode, disabling it!");
+  return size;
+}
+#endif
+
+/* Content of a checkpoint file */
+typedef struct {
+  solver_options_t options;
+  grid_t *root;
+  decision_t *decisions;
+  uint64_t *solutions_before;
+  size_t depth;
+  uint64_t nb_solutions;
+} checkpoint_t;
+
+/* Return the index of `name` in the `nb_names` first `names`, `nb_names` if
+ * it is not there */
+static size_t name_index(const char *names[], const size_t nb_names,
+                         const char *name) {
+
+  size_t index = 0;
+  while (index < nb_names && strcmp(names[index], name) != 0) {
+    index++;
   }
 
-  if (optind == argc) {
-    errx(EXIT_FAILURE, "error: no input grid given!");
+  return index;
+}
+
+/* Read the checkpoint `file_name`, exit with an error if it is not valid */
+static void checkpoint_read(checkpoint_t *checkpoint, const char *file_name) {
+
+  FILE *fd = fopen(file_name, "r");
+  if (fd == NULL) {
+    errx(EXIT_FAILURE, "error: file '%s' is not readeable or do not exist!",
+         file_name);
   }
 
-  /* Check if files are readable */
-  for (int i = optind; i < argc; i++) {
+  int version;
+  size_t size;
+  solver_options_t *options = &checkpoint->options;
+  char mode[16];
+  char schedule[16];
+  int all_different;
+  int finned;
+  int backjump;
+
+  if (fscanf(fd, "sudoku-checkpoint %d size %zu", &version, &size) != 2 ||
+      version != CHECKPOINT_VERSION ||
+      fscanf(fd, " mode %15s limit %" SCNu64 " probe %zu subset-order %zu"
+                 " all-different %d fish %zu finned %d chains %zu"
+                 " chain-budget %lf schedule %15s backjump %d",
+             mode, &options->limit, &options->probe, &options->subset_order,
+             &all_different, &options->fish, &finned, &options->chains,
+             &options->chain_budget, schedule, &backjump) != 11 ||
+      fscanf(fd, " solutions %" SCNu64 " depth %zu",
+             &checkpoint->nb_solutions, &checkpoint->depth) != 2 ||
+      !grid_check_size(size) || checkpoint->depth > size * size * size) {
+    errx(EXIT_FAILURE, "error: '%s' is not a valid checkpoint", file_name);
+  }
 
-    if (access(argv[i], R_OK) != 0) {
-      errx(EXIT_FAILURE, "error: file '%s' is not readeable or do not exist!",
-           argv[i]);
+  size_t mode_id = name_index(mode_names, 3, mode);
+  size_t schedule_id = name_index(schedule_names, 2, schedule);
+  if (mode_id == 3 || schedule_id == 2 || options->subset_order == 0 ||
+      options->chains > MAX_CHAIN_LENGTH) {
+    errx(EXIT_FAILURE, "error: '%s' is not a valid checkpoint", file_name);
+  }
+  options->mode = mode_id;
+  options->schedule = schedule_id;
+  options->all_different = all_different;
+  options->finned = finned;
+  options->backjump = backjump;
+
+  size_t depth = checkpoint->depth;
+  checkpoint->decisions = malloc((depth + 1) * sizeof(decision_t));
+  checkpoint->solutions_before = malloc((depth + 1) * sizeof(uint64_t));
+  checkpoint->root = grid_alloc(size);
+  if (checkpoint->decisions == NULL || checkpoint->solutions_before == NULL ||
+      checkpoint->root == NULL) {
+    errx(EXIT_FAILURE, "error: Error while reading checkpoint '%s'",
+         file_name);
+  }
+
+  for (size_t i = 0; i < depth; i++) {
+    decision_t *decision = &checkpoint->decisions[i];
+    size_t color_id;
+    int positive;
+
+    if (fscanf(fd, "%zu %zu %zu %d %" SCNu64, &decision->row,
+               &decision->column, &color_id, &positive,
+               &checkpoint->solutions_before[i]) != 5 ||
+        decision->row >= size || decision->column >= size ||
+        color_id >= size) {
+      errx(EXIT_FAILURE, "error: '%s' is not a valid checkpoint", file_name);
     }
+    decision->color = colors_set(color_id);
+    decision->positive = positive;
   }
 
-  fprintf(program_output, "---Solveur mode---\n");
+  for (size_t cell = 0; cell < size * size; cell++) {
+    colors_t colors;
+    if (!checkpoint_read_colors(fd, &colors)) {
+      errx(EXIT_FAILURE, "error: '%s' is not a valid checkpoint", file_name);
+    }
+    cell_write(checkpoint->root, cell, colors);
+  }
 
-  bool are_all_grids_consistent = true;
+  fclose(fd);
+}
 
-  for (int i = optind; i < argc; i++) {
+/* Warn that the option `name` of the command line gives way to the one saved
+ * in a checkpoint if `differs` */
+static void checkpoint_override(const bool differs, const char *name) {
+
+  if (differs) {
+    warnx("warning: option '%s' differs from the checkpoint, using the saved "
+          "one",
+          name);
+  }
+}
+
+/* Go on with the options saved in `checkpoint`, a search resumed with other
+ * options would neither replay nor count the same. Only the options given
+ * on the command line are warned about. */
+static void solver_options_resume(const checkpoint_t *checkpoint) {
+
+  const solver_options_t *saved = &checkpoint->options;
+  const solver_options_t *defaults = &default_solver_options;
+  solver_options_t *options = &solver_options;
+  mode_t mode = options->mode;
+
+  /* All the solutions are enumerated either way, printed or not */
+  checkpoint_override(mode != defaults->mode &&
+                          (mode == mode_first) != (saved->mode == mode_first),
+                      "all");
+  checkpoint_override(options->limit != defaults->limit &&
+                          options->limit != saved->limit,
+                      "limit");
+  checkpoint_override(options->probe != defaults->probe &&
+                          options->probe != saved->probe,
+                      "probe");
+  checkpoint_override(options->subset_order != defaults->subset_order &&
+                          options->subset_order != saved->subset_order,
+                      "subset-order");
+  checkpoint_override(options->all_different != defaults->all_different &&
+                          options->all_different != saved->all_different,
+                      "all-different");
+  checkpoint_override(options->fish != defaults->fish &&
+                          options->fish != saved->fish,
+                      "fish");
+  checkpoint_override(options->finned != defaults->finned &&
+                          options->finned != saved->finned,
+                      "finned");
+  checkpoint_override(options->chains != defaults->chains &&
+                          options->chains != saved->chains,
+                      "chains");
+  checkpoint_override(options->chain_budget != defaults->chain_budget &&
+                          options->chain_budget != saved->chain_budget,
+                      "chain-budget");
+  checkpoint_override(options->schedule != defaults->schedule &&
+                          options->schedule != saved->schedule,
+                      "schedule");
+  checkpoint_override(options->backjump != defaults->backjump &&
+                          options->backjump != saved->backjump,
+                      "backjump");
+
+  *options = *saved;
+  if ((mode == mode_first) == (saved->mode == mode_first)) {
+    options->mode = mode;
+  }
+}
+
+/**
+ * Bring `search`, set on a copy of the root grid of `checkpoint`, back to the
+ * saved path: the decisions are replayed from the root, which gives back the
+ * same grids as long as the heuristics do not depend on time (--chains).
+ * Return False if a decision does not replay.
+ */
+static bool search_replay(search_t *search, const checkpoint_t *checkpoint) {
+
+  for (size_t i = 0; i < checkpoint->depth; i++) {
+    if (search_propagate(search, search->grid) !=
+        status_code_grid_is_not_solved_and_consistent) {
+      return false;
+    }
+
+    const decision_t *decision = &checkpoint->decisions[i];
+    choice_t choice = {.row = decision->row,
+                       .column = decision->column,
+                       .color = decision->color};
+
+    search->frames[search->depth++] =
+        (frame_t){.decision = *decision,
+                  .hash = grid_hash(search->grid),
+                  .solutions_before = checkpoint->solutions_before[i]};
+
+    if (decision->positive) {
+      search_save(search);
+      grid_choice_assign(search->grid, &choice);
+    } else {
+      grid_choice_discard(search->grid, &choice);
+    }
+  }
+
+  search->nb_solutions = checkpoint->nb_solutions;
+
+  return true;
+}
+
+/* Save the stack if it is time to, and stop there on SIGINT or SIGTERM */
+static void search_checkpoint(search_t *search) {
+
+  if (checkpoint_signal != 0) {
+    checkpoint_write(search, search->checkpoint);
+    fflush(NULL);
+    warnx("search saved in '%s'", search->checkpoint);
+    exit(128 + checkpoint_signal);
+  }
+
+  time_t now = time(NULL);
+  if (now >= search->next_checkpoint) {
+    checkpoint_write(search, search->checkpoint);
+    search->next_checkpoint = now + (time_t)checkpoint_interval;
+  }
+}
+
+/**
+ * Estimate the number of nodes of the search tree from one random path down
+ * from the root (Knuth, 1975). Both children of each node of the path are
+ * propagated: the leaves are counted as they are, and the path goes on in a
+ * random other child, which stands for the subtrees of all of them.
+ */
+static double progress_estimate(const search_t *search) {
+
+  progress_t *progress = search->progress;
+  grid_t *grid = progress->probe;
+  grid_t *sibling = progress->sibling;
+  double weight = 1;
+  double estimate = 1;
+
+  grid_deep_copy(grid, search->root);
+  if (search_propagate(search, grid) !=
+      status_code_grid_is_not_solved_and_consistent) {
+    return estimate;
+  }
+
+  for (;;) {
+    choice_t *choice = grid_choice(grid);
+    grid_deep_copy(sibling, grid);
+    grid_choice_assign(grid, choice);
+    grid_choice_discard(sibling, choice);
+    grid_choice_free(choice);
+
+    bool grid_is_inner = search_propagate(search, grid) ==
+                         status_code_grid_is_not_solved_and_consistent;
+    bool sibling_is_inner = search_propagate(search, sibling) ==
+                            status_code_grid_is_not_solved_and_consistent;
+
+    estimate += 2 * weight;
+
+    if (!grid_is_inner && !sibling_is_inner) {
+      return estimate;
+    }
+
+    if (grid_is_inner && sibling_is_inner) {
+      weight *= 2;
+      if (prng_bounded(&progress->prng, 2) == 0) {
+        continue;
+      }
+    }
+
+    if (!grid_is_inner || sibling_is_inner) {
+      grid_t *tmp = grid;
+      grid = sibling;
+      sibling = tmp;
+    }
+  }
+}
+
+/* Print a number of seconds as days and hh:mm:ss */
+static void progress_print_duration(double seconds, FILE *fd) {
+
+  double days = floor(seconds / 86400);
+  unsigned rest = (unsigned)(seconds - days * 86400);
+
+  if (days > 0) {
+    fprintf(fd, "%.0fd ", days);
+  }
+  fprintf(fd, "%02u:%02u:%02u", rest / 3600, rest / 60 % 60, rest % 60);
+}
+
+/* Print the progress of `search` on stderr if it is time to */
+static void progress_report(const search_t *search) {
+
+  progress_t *progress = search->progress;
+  double now = progress_now();
+
+  if (now < progress->next_report) {
+    return;
+  }
+
+  /* The estimates add up over the reports, each one gets a share of the
+   * interval, at least one probe */
+  double deadline = now + PROGRESS_PROBE_SHARE * (double)progress_interval;
+  double end;
+  do {
+    progress->sum_estimates += progress_estimate(search);
+    progress->nb_estimates++;
+    end = progress_now();
+  } while (end < deadline);
+  progress->probe_time += end - now;
+
+  double rate =
+      search->nb_nodes / (end - progress->start - progress->probe_time);
+  double tree_size = progress->sum_estimates / progress->nb_estimates;
+
+  fprintf(stderr,
+          "progress: %.0f nodes/s, %" PRIu64 " solutions, depth %zu, ", rate,
+          search->nb_solutions, search->depth);
+
+  /* The estimate only converges after many probes, it may be behind */
+  if (tree_size > search->nb_nodes && rate > 0) {
+    fputs("ETA ", stderr);
+    progress_print_duration((tree_size - search->nb_nodes) / rate, stderr);
+    fprintf(stderr, " (%.3g nodes)\n", tree_size);
+  } else {
+    fprintf(stderr, "ETA unknown\n");
+  }
+
+  progress->next_report = end + (double)progress_interval;
+}
+
+/**
+ * Explore the choices from `search->grid` until the limit of solutions is
+ * reached or every branch is explored. Return:
+ * + 1: if the limit was reached, the grid holds the last solution
+ * + 2: otherwise
+ */
+static size_t search_run(search_t *search) {
+
+  grid_t *grid = search->grid;
+
+  for (;;) {
+    if (search->checkpoint != NULL) {
+      search_checkpoint(search);
+    }
+    if (search->progress != NULL) {
+      progress_report(search);
+    }
+
+    size_t res = search_heuristics(search, grid);
+
+    if (res == status_code_grid_is_not_solved_and_consistent) {
+
+      /* Look ahead before choosing, the removed colors are propagated
+       * first */
+      if (search->use_probe && grid_probe(grid)) {
+        continue;
+      }
+
+      grid_hash_t hash = grid_hash(grid);
+      uint64_t nb_solutions;
+
+      if (search->tt == NULL) {
+        search_push(search, hash);
+        continue;
+      }
+
+      /* When solutions are printed, only the refuted states can be
+       * skipped */
+      if (!tt_probe(search->tt, hash.key, hash.check, &nb_solutions) ||
+          (nb_solutions != 0 && !search->reuse_counts)) {
+        search_push(search, hash);
+        continue;
+      }
+
+      search->nb_solutions += nb_solutions;
+
+      /* The limit is reported, not what lies beyond it */
+      if (search_is_finished(search)) {
+        search->nb_solutions = search->limit;
+        return status_code_grid_is_solved;
+      }
+
+    } else if (res == status_code_grid_is_solved) {
+
+      search->nb_solutions++;
+      if (search->on_solution != NULL) {
+        search->on_solution(search);
+      }
+
+      if (search_is_finished(search)) {
+        return status_code_grid_is_solved;
+      }
+    }
+
+    if (!search_backtrack(search)) {
+      return status_code_grid_is_inconsistent;
+    }
+  }
+}
+
+/* Decisions that can not hold together */
+typedef struct {
+  decision_t decisions[MAX_NOGOOD_SIZE];
+  size_t size;
+} nogood_t;
+
+/* Why a color was removed from a cell */
+typedef enum {
+  reason_given,    /* Before any decision */
+  reason_decision, /* The decision of its level */
+  reason_peer,     /* A peer holds the color, `data` is the peer */
+  reason_hidden,   /* Another cell is the only one of a unit with its color,
+                    * `data` is the unit times the size plus the color */
+  reason_path      /* The other heuristics, from every decision above */
+} reason_kind_t;
+
+typedef struct {
+  uint8_t kind;
+  uint32_t level; /* Number of decisions made when the color was removed */
+  uint32_t data;
+} reason_t;
+
+/* State of the conflict-directed backjumping of a search, the decisions are
+ * its frames. The colors are removed one by one with their reason, so that a
+ * failure is explained by walking back the reasons to the decisions. A color
+ * is numbered by its cell times the size plus its index. */
+struct backjump_t {
+  search_t *search;
+  grid_t *grid;
+  size_t size;
+  size_t *trail_sizes; /* Of each frame, before its decision */
+  uint64_t **conflicts; /* Of the two branches of each frame, allocated the
+                         * first time the search gets there */
+  uint64_t root_conflict;
+  reason_t *reasons; /* Of the removed colors */
+  size_t *trail;     /* Removed colors, in order */
+  size_t trail_size;
+  uint16_t *singles; /* Cells left with one color or none, to propagate */
+  size_t nb_singles;
+  size_t *hidden; /* Units times the size plus the colors left in one cell of
+                   * the unit or none, to propagate */
+  size_t nb_hidden;
+  uint16_t *counts;     /* Cells of each unit holding each color */
+  uint16_t *units;      /* Cells of each unit */
+  uint16_t *cell_units; /* Row, column and block of each cell */
+  const uint16_t *peers;
+  size_t nb_peers;
+  size_t *stack; /* Colors left to explain */
+  size_t nb_stacked;
+  uint64_t *seen; /* Colors already stacked */
+  colors_t *before; /* Cells before grid_heuristics() */
+  nogood_t *nogoods; /* Ring buffer of the last recorded nogoods */
+  size_t max_nogoods;
+  size_t nb_nogoods;
+  size_t next_nogood;
+};
+
+static size_t backjump_max_nogoods = DEFAULT_NOGOODS;
+
+/* Conflicts are sets of decisions, stored as bitsets over their depth. Return
+ * the number of words of the conflicts of the branches of the frame at
+ * `depth`, which may hold its own decision. */
+static size_t conflict_words(const size_t depth) {
+
+  return (depth + 1) / 64 + 1;
+}
+
+static bool conflict_is_in(const uint64_t *conflict, const size_t index) {
+
+  return (conflict[index / 64] >> (index % 64)) & 1;
+}
+
+static void conflict_add(uint64_t *conflict, const size_t index) {
+
+  conflict[index / 64] |= (uint64_t)1 << (index % 64);
+}
+
+static void conflict_discard(uint64_t *conflict, const size_t index) {
+
+  conflict[index / 64] &= ~((uint64_t)1 << (index % 64));
+}
+
+/* Put every decision made so far in `conflict` */
+static void conflict_fill(const backjump_t *bj, uint64_t *conflict) {
+
+  for (size_t i = 0; i < bj->search->depth; i++) {
+    conflict_add(conflict, i);
+  }
+}
+
+/* Stack `literal` to be explained by conflict_analyze(), once */
+static void conflict_push(backjump_t *bj, const size_t literal) {
+
+  if (!bitset_is_in(bj->seen, literal)) {
+    bitset_add(bj->seen, literal);
+    bj->stack[bj->nb_stacked++] = literal;
+  }
+}
+
+/* Start the explanation of a failure, the colors stacked next are the ones
+ * that can not be all removed */
+static void conflict_start(backjump_t *bj) {
+
+  size_t size = bj->size;
+
+  memset(bj->seen, 0, (size * size * size / 64 + 1) * sizeof(uint64_t));
+  bj->nb_stacked = 0;
+}
+
+/* Put in `conflict` the decisions that explain the stacked colors: each
+ * color is replaced by the ones which removal led to its own */
+static void conflict_analyze(backjump_t *bj, uint64_t *conflict) {
+
+  size_t size = bj->size;
+  size_t path = 0; /* Levels explained by the other heuristics */
+
+  while (bj->nb_stacked > 0) {
+    size_t literal = bj->stack[--bj->nb_stacked];
+    const reason_t *reason = &bj->reasons[literal];
+    size_t cell = literal / size;
+    size_t color_id = literal % size;
+
+    if (reason->level == 0) {
+      continue;
+    }
+
+    switch (reason->kind) {
+
+    case reason_decision:
+      conflict_add(conflict, reason->level - 1);
+      break;
+
+    case reason_path:
+      if (reason->level > path) {
+        path = reason->level;
+      }
+      break;
+
+    case reason_peer:
+      for (size_t other = 0; other < size; other++) {
+        if (other != color_id) {
+          conflict_push(bj, reason->data * size + other);
+        }
+      }
+      break;
+
+    case reason_hidden: {
+      const uint16_t *unit = &bj->units[reason->data / size * size];
+      for (size_t i = 0; i < size; i++) {
+        if (unit[i] != cell) {
+          conflict_push(bj, unit[i] * size + reason->data % size);
+        }
+      }
+      break;
+    }
+
+    default:
+      break;
+    }
+  }
+
+  for (size_t i = 0; i < path; i++) {
+    conflict_add(conflict, i);
+  }
+}
+
+/* Remove `color_id` from `cell` because of `kind`, the cell and units left
+ * with one choice or none are propagated by backjump_propagate() */
+static void backjump_remove(backjump_t *bj, const size_t cell,
+                            const size_t color_id, const reason_kind_t kind,
+                            const size_t data) {
+
+  colors_t colors = bj->grid->cells[0][cell];
+  colors_t color = (colors_t)1 << color_id;
+
+  if ((colors & color) == 0) {
+    return;
+  }
+  colors &= ~color;
+  cell_write(bj->grid, cell, colors);
+  if ((colors & (colors - 1)) == 0) {
+    bj->singles[bj->nb_singles++] = cell;
+  }
+
+  size_t literal = cell * bj->size + color_id;
+  bj->reasons[literal] =
+      (reason_t){.kind = kind, .level = bj->search->depth, .data = data};
+  bj->trail[bj->trail_size++] = literal;
+
+  for (size_t i = 0; i < 3; i++) {
+    size_t unit_color = bj->cell_units[3 * cell + i] * bj->size + color_id;
+
+    if (--bj->counts[unit_color] <= 1) {
+      bj->hidden[bj->nb_hidden++] = unit_color;
+    }
+  }
+}
+
+/* Put back the colors removed after the first `trail_size` ones */
+static void backjump_undo(backjump_t *bj, const size_t trail_size) {
+
+  while (bj->trail_size > trail_size) {
+    size_t literal = bj->trail[--bj->trail_size];
+    size_t cell = literal / bj->size;
+    size_t color_id = literal % bj->size;
+
+    cell_write(bj->grid, cell,
+               bj->grid->cells[0][cell] | (colors_t)1 << color_id);
+    for (size_t i = 0; i < 3; i++) {
+      bj->counts[bj->cell_units[3 * cell + i] * bj->size + color_id]++;
+    }
+  }
+
+  bj->nb_singles = 0;
+  bj->nb_hidden = 0;
+}
+
+/* Propagate the removed colors: the color of a cell left with one is removed
+ * from its peers, and a cell left alone with a color in a unit keeps only
+ * this one. Return False on a failure, its colors are stacked. */
+static bool backjump_propagate(backjump_t *bj) {
+
+  size_t size = bj->size;
+  colors_t *cells = bj->grid->cells[0];
+
+  while (bj->nb_singles > 0 || bj->nb_hidden > 0) {
+    if (bj->nb_singles > 0) {
+      size_t cell = bj->singles[--bj->nb_singles];
+      colors_t colors = cells[cell];
+
+      if (colors == 0) {
+        conflict_start(bj);
+        for (size_t color_id = 0; color_id < size; color_id++) {
+          conflict_push(bj, cell * size + color_id);
+        }
+        return false;
+      }
+
+      size_t single = colors_count(colors - 1);
+      const uint16_t *peer = &bj->peers[cell * bj->nb_peers];
+      for (size_t i = 0; i < bj->nb_peers; i++) {
+        backjump_remove(bj, peer[i], single, reason_peer, cell);
+      }
+      continue;
+    }
+
+    size_t unit_color = bj->hidden[--bj->nb_hidden];
+    size_t color_id = unit_color % size;
+    const uint16_t *unit = &bj->units[unit_color / size * size];
+    colors_t color = (colors_t)1 << color_id;
+
+    if (bj->counts[unit_color] == 0) {
+      conflict_start(bj);
+      for (size_t i = 0; i < size; i++) {
+        conflict_push(bj, unit[i] * size + color_id);
+      }
+      return false;
+    }
+
+    size_t i = 0;
+    while ((cells[unit[i]] & color) == 0) {
+      i++;
+    }
+    for (size_t other = 0; other < size; other++) {
+      if (other != color_id) {
+        backjump_remove(bj, unit[i], other, reason_hidden, unit_color);
+      }
+    }
+  }
+
+  return true;
+}
+
+/* Run backjump_propagate() then grid_heuristics() until they both hold, the
+ * colors removed by the latter are put back and removed again with the whole
+ * path as their reason. On a failure, `conflict` is filled with its
+ * decisions. */
+static size_t backjump_heuristics(backjump_t *bj, uint64_t *conflict) {
+
+  size_t size = bj->size;
+  grid_t *grid = bj->grid;
+
+  while (true) {
+    if (!backjump_propagate(bj)) {
+      conflict_analyze(bj, conflict);
+      return status_code_grid_is_inconsistent;
+    }
+
+    grid_get_colors(grid, bj->before);
+    size_t res = grid_heuristics(grid, true);
+    if (res == status_code_grid_is_inconsistent) {
+      grid_set_colors(grid, bj->before);
+      conflict_fill(bj, conflict);
+      return res;
+    }
+
+    for (size_t cell = 0; cell < size * size; cell++) {
+      colors_t removed = bj->before[cell] & ~grid->cells[0][cell];
+      if (removed == 0) {
+        continue;
+      }
+
+      cell_write(grid, cell, bj->before[cell]);
+      for (size_t color_id = 0; color_id < size; color_id++) {
+        if ((removed >> color_id) & 1) {
+          backjump_remove(bj, cell, color_id, reason_path, 0);
+        }
+      }
+    }
+
+    /* The heuristics missed nothing of the propagation */
+    size_t trail_size = bj->trail_size;
+    if (!backjump_propagate(bj)) {
+      conflict_analyze(bj, conflict);
+      return status_code_grid_is_inconsistent;
+    }
+    if (bj->trail_size == trail_size) {
+      return res;
+    }
+  }
+}
+
+/* Return True if `decision` holds in `grid` */
+static bool decision_holds(const grid_t *grid, const decision_t *decision) {
+
+  colors_t colors = grid->cells[decision->row][decision->column];
+
+  if (decision->positive) {
+    return colors == decision->color;
+  }
+  return colors_and(colors, decision->color) == 0;
+}
+
+/* Record `conflict` in the nogood cache if it is small enough */
+static void nogood_record(backjump_t *bj, const uint64_t *conflict) {
+
+  nogood_t nogood = {.size = 0};
+
+  for (size_t i = 0; i < bj->search->depth; i++) {
+    if (conflict_is_in(conflict, i)) {
+      if (nogood.size == MAX_NOGOOD_SIZE) {
+        return;
+      }
+      nogood.decisions[nogood.size++] = bj->search->frames[i].decision;
+    }
+  }
+
+  if (nogood.size == 0 || bj->max_nogoods == 0) {
+    return;
+  }
+
+  bj->nogoods[bj->next_nogood] = nogood;
+  bj->next_nogood = (bj->next_nogood + 1) % bj->max_nogoods;
+  if (bj->nb_nogoods < bj->max_nogoods) {
+    bj->nb_nogoods++;
+  }
+}
+
+/* Return True if every decision of a recorded nogood holds in `grid` */
+static bool nogood_is_violated(const backjump_t *bj, const grid_t *grid) {
+
+  for (size_t i = 0; i < bj->nb_nogoods; i++) {
+    const nogood_t *nogood = &bj->nogoods[i];
+    size_t j = 0;
+
+    while (j < nogood->size && decision_holds(grid, &nogood->decisions[j])) {
+      j++;
+    }
+
+    if (j == nogood->size) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/* Fill the cells of each unit of `bj`, numbered as by grid_unit(), and the
+ * units of each cell */
+static void backjump_units(backjump_t *bj) {
+
+  size_t size = bj->size;
+  size_t size_sqrt = get_sqrt(size);
+
+  for (size_t row = 0; row < size; row++) {
+    for (size_t column = 0; column < size; column++) {
+      size_t cell = row * size + column;
+      size_t block = (row / size_sqrt) * size_sqrt + column / size_sqrt;
+      size_t index = (row % size_sqrt) * size_sqrt + column % size_sqrt;
+
+      bj->units[row * size + column] = cell;
+      bj->units[(size + column) * size + row] = cell;
+      bj->units[(2 * size + block) * size + index] = cell;
+      bj->cell_units[3 * cell] = row;
+      bj->cell_units[3 * cell + 1] = size + column;
+      bj->cell_units[3 * cell + 2] = 2 * size + block;
+    }
+  }
+}
+
+/* Set backjumping up for `search`, on its grid before any decision */
+static backjump_t *backjump_alloc(search_t *search) {
+
+  grid_t *grid = search->grid;
+  size_t size = grid_get_size(grid);
+  size_t nb_colors = size * size * size;
+  backjump_t *bj = malloc(sizeof(backjump_t));
+  if (bj == NULL) {
+    errx(EXIT_FAILURE, "error: Error while allocating the search\n");
+  }
+
+  *bj = (backjump_t){
+      .search = search,
+      .grid = grid,
+      .size = size,
+      .trail_sizes = malloc(search->max_depth * sizeof(size_t)),
+      .conflicts = calloc(search->max_depth, sizeof(uint64_t *)),
+      .reasons = calloc(nb_colors, sizeof(reason_t)),
+      .trail = malloc(nb_colors * sizeof(size_t)),
+      .singles = malloc(2 * size * size * sizeof(uint16_t)),
+      .hidden = malloc(6 * size * size * sizeof(size_t)),
+      .counts = calloc(3 * size * size, sizeof(uint16_t)),
+      .units = malloc(3 * size * size * sizeof(uint16_t)),
+      .cell_units = malloc(3 * size * size * sizeof(uint16_t)),
+      .peers = peers_get(size),
+      .nb_peers = peers_count(size),
+      .stack = malloc(nb_colors * sizeof(size_t)),
+      .seen = malloc((nb_colors / 64 + 1) * sizeof(uint64_t)),
+      .before = malloc(size * size * sizeof(colors_t)),
+      .nogoods = malloc(backjump_max_nogoods * sizeof(nogood_t)),
+      .max_nogoods = backjump_max_nogoods};
+
+  if (bj->trail_sizes == NULL || bj->conflicts == NULL ||
+      bj->reasons == NULL || bj->trail == NULL || bj->singles == NULL ||
+      bj->hidden == NULL || bj->counts == NULL || bj->units == NULL ||
+      bj->cell_units == NULL || bj->peers == NULL || bj->stack == NULL ||
+      bj->seen == NULL || bj->before == NULL ||
+      (bj->nogoods == NULL && backjump_max_nogoods != 0)) {
+    errx(EXIT_FAILURE, "error: Error while allocating the search\n");
+  }
+
+  backjump_units(bj);
+  for (size_t cell = 0; cell < size * size; cell++) {
+    for (size_t color_id = 0; color_id < size; color_id++) {
+      if ((grid->cells[0][cell] >> color_id) & 1) {
+        for (size_t i = 0; i < 3; i++) {
+          bj->counts[bj->cell_units[3 * cell + i] * size + color_id]++;
+        }
+      }
+    }
+  }
+
+  return bj;
+}
+
+static void backjump_free(backjump_t *bj) {
+
+  if (bj == NULL) {
+    return;
+  }
+
+  for (size_t depth = 0; depth < bj->search->max_depth; depth++) {
+    free(bj->conflicts[depth]);
+  }
+  free(bj->trail_sizes);
+  free(bj->conflicts);
+  free(bj->reasons);
+  free(bj->trail);
+  free(bj->singles);
+  free(bj->hidden);
+  free(bj->counts);
+  free(bj->units);
+  free(bj->cell_units);
+  free(bj->stack);
+  free(bj->seen);
+  free(bj->before);
+  free(bj->nogoods);
+  free(bj);
+}
+
+/* Start the frame at `depth` with empty conflicts, they are allocated the
+ * first time the search gets there and kept for the next frames there */
+static void backjump_frame(backjump_t *bj, const size_t depth) {
+
+  size_t words = conflict_words(depth);
+
+  if (bj->conflicts[depth] == NULL) {
+    bj->conflicts[depth] = malloc(2 * words * sizeof(uint64_t));
+    if (bj->conflicts[depth] == NULL) {
+      errx(EXIT_FAILURE, "error: Error while allocating a conflict\n");
+    }
+  }
+  memset(bj->conflicts[depth], 0, 2 * words * sizeof(uint64_t));
+}
+
+/* Return the conflict filled by a failure of the node at `depth`: the one of
+ * its branch in the frame above, the root has its own */
+static uint64_t *backjump_conflict(backjump_t *bj, const size_t depth) {
+
+  if (depth == 0) {
+    return &bj->root_conflict;
+  }
+
+  uint64_t *first = bj->conflicts[depth - 1];
+  if (bj->search->frames[depth - 1].decision.positive) {
+    return first;
+  }
+  return first + conflict_words(depth - 1);
+}
+
+/* Remove the colors of the cell of `decision` as its branch does */
+static void backjump_decide(backjump_t *bj, const decision_t *decision) {
+
+  size_t cell = decision->row * bj->size + decision->column;
+  size_t color_id = colors_count(decision->color - 1);
+
+  if (!decision->positive) {
+    backjump_remove(bj, cell, color_id, reason_decision, 0);
+    return;
+  }
+
+  for (size_t other = 0; other < bj->size; other++) {
+    if (other != color_id) {
+      backjump_remove(bj, cell, other, reason_decision, 0);
+    }
+  }
+}
+
+/* Go down the first branch of the choice of the grid of `search` */
+static void backjump_push(search_t *search) {
+
+  backjump_t *bj = search->backjump;
+  size_t depth = search->depth;
+
+  assert(depth < search->max_depth);
+
+  choice_t *choice = grid_choice(search->grid);
+  assert(choice != NULL);
+
+  search->frames[depth] =
+      (frame_t){.decision = {.row = choice->row,
+                             .column = choice->column,
+                             .color = choice->color,
+                             .positive = true},
+                .solutions_before = search->nb_solutions};
+  bj->trail_sizes[depth] = bj->trail_size;
+  backjump_frame(bj, depth);
+  search->depth++;
+  search->nb_nodes++;
+  grid_choice_free(choice);
+
+  backjump_decide(bj, &search->frames[depth].decision);
+}
+
+/**
+ * Go to the next branch left on the stack, return False if there is none.
+ * When the first branch of a choice failed without the choice being part of
+ * its conflict, the second branch would fail the same way and is skipped:
+ * the search jumps back to the deepest decision of the conflict.
+ */
+static bool backjump_backtrack(search_t *search) {
+
+  backjump_t *bj = search->backjump;
+
+  while (search->depth > 0) {
+    size_t depth = search->depth - 1;
+    frame_t *frame = &search->frames[depth];
+    uint64_t *first = bj->conflicts[depth];
+    uint64_t *second = first + conflict_words(depth);
+    bool has_solutions = search->nb_solutions != frame->solutions_before;
+
+    backjump_undo(bj, bj->trail_sizes[depth]);
+
+    if (frame->decision.positive &&
+        (has_solutions || conflict_is_in(first, depth))) {
+      frame->decision.positive = false;
+      search->nb_nodes++;
+      backjump_decide(bj, &frame->decision);
+
+      return true;
+    }
+
+    search->depth--;
+    uint64_t *conflict = backjump_conflict(bj, depth);
+
+    if (frame->decision.positive) {
+      /* Backjump */
+      memcpy(conflict, first, (depth / 64 + 1) * sizeof(uint64_t));
+    } else if (has_solutions) {
+      /* Solutions may be anywhere below, no jump goes past them */
+      conflict_fill(bj, conflict);
+    } else {
+      /* The discarded color is implied by the conflict of the first
+       * branch */
+      memcpy(conflict, second, (depth / 64 + 1) * sizeof(uint64_t));
+      if (conflict_is_in(second, depth)) {
+        for (size_t i = 0; i < depth; i++) {
+          if (conflict_is_in(first, i)) {
+            conflict_add(conflict, i);
+          }
+        }
+      }
+      conflict_discard(conflict, depth);
+      nogood_record(bj, conflict);
+    }
+  }
+
+  return false;
+}
+
+/**
+ * Same as search_run() with conflict-directed backjumping, the failures fill
+ * the conflicts of their branches with the decisions that caused them, see
+ * backjump_backtrack(). The table and the probes are not used.
+ */
+static size_t backjump_run(search_t *search) {
+
+  backjump_t *bj = search->backjump;
+
+  for (;;) {
+    if (search->checkpoint != NULL) {
+      search_checkpoint(search);
+    }
+    if (search->progress != NULL) {
+      progress_report(search);
+    }
+
+    uint64_t *conflict = backjump_conflict(bj, search->depth);
+    size_t res = backjump_heuristics(bj, conflict);
+
+    if (res == status_code_grid_is_not_solved_and_consistent) {
+      if (!nogood_is_violated(bj, search->grid)) {
+        backjump_push(search);
+        continue;
+      }
+      conflict_fill(bj, conflict);
+
+    } else if (res == status_code_grid_is_solved) {
+
+      search->nb_solutions++;
+      if (search->on_solution != NULL) {
+        search->on_solution(search);
+      }
+
+      if (search_is_finished(search)) {
+        return status_code_grid_is_solved;
+      }
+
+      /* Later failures may depend on any decision leading to a solution */
+      conflict_fill(bj, conflict);
+    }
+
+    if (!backjump_backtrack(search)) {
+      return status_code_grid_is_inconsistent;
+    }
+  }
+}
+
+/* Same as search_replay() with backjumping. The conflicts of the first
+ * branches explored before the checkpoint are lost, they stand for every
+ * decision above, which only jumps back less far. */
+static bool backjump_replay(search_t *search, const checkpoint_t *checkpoint) {
+
+  backjump_t *bj = search->backjump;
+
+  for (size_t i = 0; i < checkpoint->depth; i++) {
+    if (backjump_heuristics(bj, backjump_conflict(bj, i)) !=
+        status_code_grid_is_not_solved_and_consistent) {
+      return false;
+    }
+
+    search->frames[i] =
+        (frame_t){.decision = checkpoint->decisions[i],
+                  .solutions_before = checkpoint->solutions_before[i]};
+    bj->trail_sizes[i] = bj->trail_size;
+    backjump_frame(bj, i);
+    search->depth++;
+
+    if (!checkpoint->decisions[i].positive) {
+      conflict_fill(bj, bj->conflicts[i]);
+    }
+    backjump_decide(bj, &checkpoint->decisions[i]);
+  }
+
+  search->nb_solutions = checkpoint->nb_solutions;
+
+  return true;
+}
+
+/* Where and how grid_solver() prints its solutions */
+typedef struct {
+  mode_t mode;
+  FILE *fd;
+} solver_output_t;
+
+static void solver_on_solution(search_t *search) {
+
+  const solver_output_t *output = search->data;
+
+  solution_print(search->grid, output->mode, search->nb_solutions,
+                 output->fd);
+}
+
+/* Set `search` up for the solver and its options */
+static void solver_setup(search_t *search, solver_output_t *output) {
+
+  search->use_locked_candidates = true;
+  search->use_probe = true;
+  search->tt = solver_tt;
+  search->reuse_counts = (output->mode == mode_count);
+  search->limit = solution_limit;
+  search->on_solution = solver_on_solution;
+  search->data = output;
+
+  if (search->root == NULL &&
+      (checkpoint_file != NULL || progress_interval != 0)) {
+    search->root = grid_copy(search->grid);
+    if (search->root == NULL) {
+      errx(EXIT_FAILURE, "error: Error while doing a deep code of grid\n");
+    }
+  }
+
+  if (checkpoint_file != NULL) {
+    search->checkpoint = checkpoint_file;
+    search->next_checkpoint = time(NULL) + (time_t)checkpoint_interval;
+  }
+
+  /* The rows of the bitboards are words, larger grids go without */
+  if (use_bitboard && grid_get_size(search->grid) <= 64) {
+    size_t size = grid_get_size(search->grid);
+    search->bitboard = bitboard_alloc(size);
+    search->bitboard_cells = malloc(size * size * sizeof(colors_t));
+    if (search->bitboard == NULL || search->bitboard_cells == NULL) {
+      errx(EXIT_FAILURE, "error: Error while allocating the bitboard");
+    }
+  }
+
+  if (progress_interval != 0) {
+    search->progress = progress_alloc(search->root);
+    if (search->progress == NULL) {
+      errx(EXIT_FAILURE, "error: Error while allocating the progress");
+    }
+  }
+
+  if (solver_options.backjump) {
+    search->backjump = backjump_alloc(search);
+  }
+}
+
+/**
+ * Solve `grid`, print its solutions in `fd` according to `mode` and count
+ * them in `count_solved_grid`. Return:
+ * + 1: if the limit of solutions was reached
+ * + 2: otherwise
+ */
+static size_t grid_solver(grid_t *grid, const mode_t mode, FILE *fd) {
+
+  search_t search;
+  solver_output_t output = {.mode = mode, .fd = fd};
+
+  search_init(&search, grid);
+  solver_setup(&search, &output);
+
+  size_t res =
+      search.backjump != NULL ? backjump_run(&search) : search_run(&search);
+  count_solved_grid = search.nb_solutions;
+  backjump_free(search.backjump);
+  search_release(&search);
+
+  return res;
+}
+
+/* Same as grid_solver(), from the state saved in `checkpoint` */
+static size_t grid_solver_resume(const checkpoint_t *checkpoint,
+                                 const mode_t mode, FILE *fd) {
+
+  search_t search;
+  solver_output_t output = {.mode = mode, .fd = fd};
+  grid_t *grid = grid_copy(checkpoint->root);
+  if (grid == NULL) {
+    errx(EXIT_FAILURE, "error: Error while doing a deep code of grid\n");
+  }
+
+  search_init(&search, grid);
+  search.root = grid_copy(checkpoint->root);
+  solver_setup(&search, &output);
+
+  bool replays = search.backjump != NULL
+                     ? backjump_replay(&search, checkpoint)
+                     : search_replay(&search, checkpoint);
+  if (!replays) {
+    errx(EXIT_FAILURE, "error: the checkpoint does not replay with these "
+                       "options");
+  }
+
+  size_t res =
+      search.backjump != NULL ? backjump_run(&search) : search_run(&search);
+  count_solved_grid = search.nb_solutions;
+  backjump_free(search.backjump);
+  search_release(&search);
+  grid_free(grid);
+
+  return res;
+}
+
+/**
+ * Expand the choices of `grid` down to `split_depth` decisions and write each
+ * node left there in `directory` as a shard: a checkpoint of depth 0 whose
+ * root is the node, counted on its own by --solve-shard. Solved grids met on
+ * the way are shards too, so the counts of the shards add up to the count of
+ * the grid. Return the number of shards written.
+ */
+static size_t grid_split(grid_t *grid, const size_t split_depth,
+                         const char *directory) {
+
+  size_t nb_shards = 0;
+  size_t length = strlen(directory) + 32;
+  char *file_name = malloc(length);
+  if (file_name == NULL) {
+    errx(EXIT_FAILURE, "error: Error while writing shards in '%s'", directory);
+  }
+
+  if (mkdir(directory, 0777) != 0 && errno != EEXIST) {
+    errx(EXIT_FAILURE, "error: Error while creating directory '%s'",
+         directory);
+  }
+
+  /* No transposition table, a skipped node would be a lost shard */
+  search_t search;
+  search_init(&search, grid);
+  search.use_locked_candidates = true;
+  search.use_probe = true;
+
+  for (;;) {
+    size_t res = search_propagate(&search, search.grid);
+
+    if (res == status_code_grid_is_not_solved_and_consistent &&
+        search.depth < split_depth) {
+      search_push(&search, grid_hash(search.grid));
+      continue;
+    }
+
+    if (res != status_code_grid_is_inconsistent) {
+      snprintf(file_name, length, "%s/shard-%06zu", directory, nb_shards++);
+      checkpoint_write(&(search_t){.root = search.grid}, file_name);
+    }
+
+    if (!search_backtrack(&search)) {
+      break;
+    }
+  }
+
+  search_release(&search);
+  free(file_name);
+
+  return nb_shards;
+}
+
+/* Add the numbers of solutions reported in the output `file_name` to
+ * `total`, return how many reports were found */
+static size_t merge_file(const char *file_name, count_t *total) {
+
+  FILE *fd = fopen(file_name, "r");
+  if (fd == NULL) {
+    errx(EXIT_FAILURE, "error: file '%s' is not readeable or do not exist!",
+         file_name);
+  }
+
+  char line[1024];
+  size_t prefix_length = strlen(SOLUTIONS_REPORT);
+  size_t nb_reports = 0;
+
+  while (fgets(line, sizeof(line), fd) != NULL) {
+    if (strncmp(line, SOLUTIONS_REPORT, prefix_length) != 0) {
+      continue;
+    }
+
+    const char *digit = line + prefix_length;
+    count_t count = 0;
+
+    if (*digit < '0' || *digit > '9') {
+      errx(EXIT_FAILURE, "error: invalid report in '%s'", file_name);
+    }
+    for (; *digit >= '0' && *digit <= '9'; digit++) {
+      if (count > (~(count_t)0 - (count_t)(*digit - '0')) / 10) {
+        errx(EXIT_FAILURE, "error: count overflow in '%s'", file_name);
+      }
+      count = count * 10 + (count_t)(*digit - '0');
+    }
+
+    if (*total > ~(count_t)0 - count) {
+      errx(EXIT_FAILURE, "error: count overflow in '%s'", file_name);
+    }
+    *total += count;
+    nb_reports++;
+  }
+
+  fclose(fd);
+
+  return nb_reports;
+}
+
+/* Write `count` in decimal in `fd` */
+static void count_print(count_t count, FILE *fd) {
+
+  char digits[40];
+  size_t nb_digits = 0;
+
+  do {
+    digits[nb_digits++] = '0' + (char)(count % 10);
+    count /= 10;
+  } while (count != 0);
+
+  while (nb_digits > 0) {
+    fputc(digits[--nb_digits], fd);
+  }
+}
+
+/* Find the root of `cell` in the union-find forest, halving the path */
+static size_t component_find(size_t *parent, size_t cell) {
+
+  while (parent[cell] != cell) {
+    parent[cell] = parent[parent[cell]];
+    cell = parent[cell];
+  }
+
+  return cell;
+}
+
+/**
+ * Split the `unsolved` cells in regions that do not interact: two cells
+ * interact if they are in the same unit and share a color. Fill `component`
+ * with the region (numbered from 0) of each unsolved cell and return the
+ * number of regions.
+ */
+static size_t grid_components(grid_t *grid, const uint64_t *unsolved,
+                              size_t *component) {
+
+  size_t size = grid->size;
+  size_t nb_cells = size * size;
+  size_t *parent = malloc(nb_cells * sizeof(size_t));
+  if (parent == NULL) {
+    errx(EXIT_FAILURE, "error: Error while splitting the grid\n");
+  }
+
+  for (size_t cell = 0; cell < nb_cells; cell++) {
+    parent[cell] = cell;
+  }
+
+  /* In each unit, every cell is joined with the first cell holding each of
+   * its colors */
+  colors_t *subgrid[size];
+  size_t first[MAX_COLORS];
+
+  for (size_t unit = 0; unit < 3 * size; unit++) {
+    grid_unit(grid, unit, subgrid);
+
+    for (size_t color_id = 0; color_id < size; color_id++) {
+      first[color_id] = nb_cells;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+      size_t cell = (size_t)(subgrid[i] - grid->cells[0]);
+
+      if (!bitset_is_in(unsolved, cell)) {
+        continue;
+      }
+
+      colors_t colors = *subgrid[i];
+      while (colors != 0) {
+        colors_t color = colors_rightmost(colors);
+        size_t color_id = colors_count(color - 1);
+        colors = colors_subtract(colors, color);
+
+        if (first[color_id] == nb_cells) {
+          first[color_id] = cell;
+        } else {
+          parent[component_find(parent, cell)] =
+              component_find(parent, first[color_id]);
+        }
+      }
+    }
+  }
+
+  /* Number the roots in `component`, then label the other cells */
+  size_t nb_components = 0;
+
+  for (size_t cell = 0; cell < nb_cells; cell++) {
+    if (bitset_is_in(unsolved, cell) && component_find(parent, cell) == cell) {
+      component[cell] = nb_components++;
+    }
+  }
+  for (size_t cell = 0; cell < nb_cells; cell++) {
+    if (bitset_is_in(unsolved, cell)) {
+      component[cell] = component[component_find(parent, cell)];
+    }
+  }
+
+  free(parent);
+
+  return nb_components;
+}
+
+/**
+ * The snapshots of grid_count(), one per depth: a node saves `grid` in its
+ * own and restores it between its branches, so the grid is never copied.
+ */
+typedef struct {
+  unsigned char *snapshots;
+  size_t snapshot_bytes;
+  size_t nb_depths; /* Number of allocated snapshots */
+} counter_t;
+
+/* Return the snapshot of `depth` in `counter`, allocating it if needed */
+static unsigned char *counter_snapshot(counter_t *counter, size_t depth) {
+
+  if (depth == counter->nb_depths) {
+    size_t nb_depths = counter->nb_depths + counter->nb_depths / 2 +
+                       SNAPSHOTS_CHUNK;
+    unsigned char *snapshots =
+        realloc(counter->snapshots, nb_depths * counter->snapshot_bytes);
+    if (snapshots == NULL) {
+      errx(EXIT_FAILURE, "error: Error while allocating the search stack\n");
+    }
+    counter->snapshots = snapshots;
+    counter->nb_depths = nb_depths;
+  }
+
+  return counter->snapshots + depth * counter->snapshot_bytes;
+}
+
+/**
+ * Count the solutions of the `cells` of `grid`, without printing them. The
+ * unsolved cells are split in regions that do not interact, each one is
+ * counted on its own and the counts are multiplied. The node saves `grid` in
+ * the snapshot of its `depth` in `counter` and leaves `grid` modified.
+ */
+static count_t grid_count(grid_t *grid, const uint64_t *cells,
+                          counter_t *counter, size_t depth) {
+
+  if (grid_heuristics(grid, true) == status_code_grid_is_inconsistent) {
+    return 0;
+  }
+
+  size_t size = grid->size;
+  size_t nb_cells = size * size;
+  size_t nb_words = nb_cells / 64 + 1;
+  uint64_t unsolved[nb_words];
+  size_t choice_cell = nb_cells;
+  size_t choice_count = size + 1;
+  grid_hash_t hash = grid_hash(grid);
+
+  for (size_t word = 0; word < nb_words; word++) {
+    unsolved[word] = 0;
+  }
+
+  for (size_t cell = 0; cell < nb_cells; cell++) {
+    size_t count = colors_count(grid->cells[0][cell]);
+
+    if (bitset_is_in(cells, cell) && count > 1) {
+      bitset_add(unsolved, cell);
+      if (count < choice_count) {
+        choice_cell = cell;
+        choice_count = count;
+      }
+    }
+  }
+
+  if (choice_cell == nb_cells) {
+    return 1;
+  }
+
+  /* The count depends on the cells it is about */
+  for (size_t word = 0; word < nb_words; word++) {
+    uint64_t z = (unsolved[word] + word) * 0x9E3779B97F4A7C15;
+    hash.key = ((hash.key ^ z) ^ ((hash.key ^ z) >> 29)) * 0xBF58476D1CE4E5B9;
+    hash.check =
+        ((hash.check ^ z) ^ ((hash.check ^ z) >> 32)) * 0xD6E8FEB86659FD93;
+  }
+
+  uint64_t stored;
+  if (solver_tt != NULL &&
+      tt_probe(solver_tt, hash.key, hash.check, &stored)) {
+    return stored;
+  }
+
+  size_t *component = malloc(nb_cells * sizeof(size_t));
+  if (component == NULL) {
+    errx(EXIT_FAILURE, "error: Error while splitting the grid\n");
+  }
+
+  size_t nb_components = grid_components(grid, unsolved, component);
+  count_t nb_solutions;
+
+  if (nb_components > 1) {
+    nb_solutions = 1;
+
+    for (size_t k = 0; k < nb_components && nb_solutions != 0; k++) {
+      uint64_t region[nb_words];
+
+      for (size_t word = 0; word < nb_words; word++) {
+        region[word] = 0;
+      }
+      for (size_t cell = 0; cell < nb_cells; cell++) {
+        if (bitset_is_in(unsolved, cell) && component[cell] == k) {
+          bitset_add(region, cell);
+        }
+      }
+
+      /* The snapshot may move when a deeper one is allocated */
+      if (k == 0) {
+        grid_pack(grid, counter_snapshot(counter, depth));
+      } else {
+        grid_unpack(grid, counter->snapshots + depth * counter->snapshot_bytes);
+      }
+      nb_solutions *= grid_count(grid, region, counter, depth + 1);
+    }
+  } else {
+    choice_t choice = {.row = choice_cell / size,
+                       .column = choice_cell % size,
+                       .color = colors_rightmost(grid->cells[0][choice_cell])};
+
+    grid_pack(grid, counter_snapshot(counter, depth));
+    grid_choice_apply(grid, &choice);
+    nb_solutions = grid_count(grid, unsolved, counter, depth + 1);
+
+    grid_unpack(grid, counter->snapshots + depth * counter->snapshot_bytes);
+    grid_choice_discard(grid, &choice);
+    nb_solutions += grid_count(grid, unsolved, counter, depth + 1);
+  }
+
+  free(component);
+
+  if (solver_tt != NULL && nb_solutions <= UINT64_MAX) {
+    tt_store(solver_tt, hash.key, hash.check, (uint64_t)nb_solutions);
+  }
+
+  return nb_solutions;
+}
+
+/* Count the solutions of `grid` by regions, see grid_count() */
+static count_t grid_count_by_regions(grid_t *grid) {
+
+  size_t nb_cells = grid->size * grid->size;
+  uint64_t cells[nb_cells / 64 + 1];
+
+  for (size_t word = 0; word < nb_cells / 64 + 1; word++) {
+    cells[word] = 0;
+  }
+  for (size_t cell = 0; cell < nb_cells; cell++) {
+    bitset_add(cells, cell);
+  }
+
+  counter_t counter = {.snapshots = NULL,
+                       .snapshot_bytes = nb_cells * grid_cell_bytes(grid->size),
+                       .nb_depths = 0};
+  count_t nb_solutions = grid_count(grid, cells, &counter, 0);
+  free(counter.snapshots);
+
+  return nb_solutions;
+}
+
+/**
+ * Return:
+ * + 1: if the `limit`-th solution was found, it is left in `grid`
+ * + 2: otherwise
+ *
+ * Solutions are counted in `nb_solutions` rather than in `count_solved_grid`
+ * so that several generators can run concurrently: 1 fills a grid, 2 checks
+ * that it is unique.
+ */
+static size_t grid_solver_for_generator(grid_t *grid, const size_t limit,
+                                        size_t *nb_solutions) {
+
+  search_t search;
+
+  search_init(&search, grid);
+  search.limit = limit;
+  search.nb_solutions = *nb_solutions;
+
+  size_t res = search_run(&search);
+  *nb_solutions = search.nb_solutions;
+  search_release(&search);
+
+  return res;
+}
+
+/* Return True if `grid` has exactly one solution, `grid` is left untouched */
+static bool grid_is_unique(const grid_t *grid) {
+
+  size_t nb_solutions = 0;
+  grid_t *grid_cpy = grid_copy(grid);
+  if (grid_cpy == NULL) {
+    errx(EXIT_FAILURE, "error: Error while doing a deep code of grid\n");
+  }
+
+  grid_solver_for_generator(grid_cpy, 2, &nb_solutions);
+  grid_free(grid_cpy);
+
+  return nb_solutions == 1;
+}
+
+/* Candidate removals of a minimal grid, probed concurrently */
+typedef struct {
+  const grid_t *grid; /* Clues of the grid, read only during a round */
+  choice_t **candidates;
+  bool *is_removable;
+  size_t nb_candidates;
+  atomic_size_t next; /* Next candidate to be probed */
+} probes_t;
+
+/* Check whether the grid keeps a unique solution without each candidate */
+static void *probe_worker(void *arg) {
+
+  probes_t *probes = arg;
+  size_t i;
+
+  while ((i = atomic_fetch_add(&probes->next, 1)) < probes->nb_candidates) {
+    size_t nb_solutions = 0;
+    grid_t *grid_cpy = grid_copy(probes->grid);
+    if (grid_cpy == NULL) {
+      errx(EXIT_FAILURE, "error: Error while doing a deep code of grid\n");
+    }
+
+    grid_choice_blank(grid_cpy, probes->candidates[i]);
+    grid_solver_for_generator(grid_cpy, 2, &nb_solutions);
+    probes->is_removable[i] = (nb_solutions == 1);
+    grid_free(grid_cpy);
+  }
+
+  return NULL;
+}
+
+/**
+ * Remove clues from the solved `grid` until every remaining clue is necessary
+ * to keep a unique solution.
+ *
+ * Each round probes the next `nb_threads` cells of the schedule in parallel.
+ * A rejected removal is final: clues are only removed afterwards, so the grid
+ * would still have several solutions without it. Accepted removals are
+ * committed together when the grid stays unique without all of them, otherwise
+ * only the first one is and the others are probed again on the next round.
+ */
+static void grid_minimize(grid_t *grid, const size_t nb_threads,
+                          prng_t *prng) {
+
+  removal_t *removal = grid_removal_alloc(grid, prng);
+  if (removal == NULL) {
+    errx(EXIT_FAILURE, "error: Error while allocating removal schedule\n");
+  }
+
+  /* `nb_threads` comes from the command line, too much for the stack */
+  choice_t **candidates = malloc(nb_threads * sizeof(choice_t *));
+  choice_t **accepted = malloc(nb_threads * sizeof(choice_t *));
+  bool *is_removable = malloc(nb_threads * sizeof(bool));
+  pthread_t *threads = malloc(nb_threads * sizeof(pthread_t));
+  if (candidates == NULL || accepted == NULL || is_removable == NULL ||
+      threads == NULL) {
+    errx(EXIT_FAILURE, "error: Error while allocating probing threads\n");
+  }
+
+  probes_t probes = {
+      .grid = grid, .candidates = candidates, .is_removable = is_removable};
+
+  while (true) {
+
+    choice_t *choice;
+    probes.nb_candidates = 0;
+
+    while (probes.nb_candidates < nb_threads &&
+           (choice = grid_removal_next(removal, grid)) != NULL) {
+      grid_choice_apply(grid, choice); /* Kept until the round is probed */
+      candidates[probes.nb_candidates++] = choice;
+    }
+
+    if (probes.nb_candidates == 0) {
+      break;
+    }
+
+    atomic_init(&probes.next, 0);
+    for (size_t t = 1; t < probes.nb_candidates; t++) {
+      if (pthread_create(&threads[t], NULL, probe_worker, &probes) != 0) {
+        errx(EXIT_FAILURE, "error: Error while creating probing threads");
+      }
+    }
+    probe_worker(&probes);
+    for (size_t t = 1; t < probes.nb_candidates; t++) {
+      pthread_join(threads[t], NULL);
+    }
+
+    size_t nb_accepted = 0;
+    for (size_t i = 0; i < probes.nb_candidates; i++) {
+      if (is_removable[i]) {
+        grid_choice_blank(grid, candidates[i]);
+        accepted[nb_accepted++] = candidates[i];
+      } else {
+        grid_removal_restore(removal, grid, candidates[i]);
+      }
+    }
+
+    if (nb_accepted > 1 && !grid_is_unique(grid)) {
+      for (size_t i = nb_accepted - 1; i > 0; i--) {
+        grid_removal_retry(removal, grid, accepted[i]);
+      }
+    }
+
+    for (size_t i = 0; i < probes.nb_candidates; i++) {
+      grid_choice_free(candidates[i]);
+    }
+  }
+
+  grid_removal_free(removal);
+  free(candidates);
+  free(accepted);
+  free(is_removable);
+  free(threads);
+}
+
+/**
+ * Return the difficulty level of `grid`, from 1 to 5 depending on the hardest
+ * technique needed by grid_rate(). The rating stops early, returning a level
+ * above `max_level`, as soon as the grid is known to be harder.
+ */
+static size_t grid_difficulty(const grid_t *grid, const size_t max_level) {
+
+  rating_t rating;
+  grid_t *grid_cpy = grid_copy(grid);
+  if (grid_cpy == NULL) {
+    errx(EXIT_FAILURE, "error: Error while doing a deep code of grid\n");
+  }
+
+  grid_rate(grid_cpy, &rating, max_level - 1);
+  grid_free(grid_cpy);
+
+  return rating.hardest + 1;
+}
+
+/**
+ * Remove clues from the solved `grid` as long as it stays unique and no harder
+ * than `difficulty`. Return True if the grid ends exactly at `difficulty`.
+ *
+ * Below the guessing level, a grid solved by the rater only needed logic and
+ * therefore has a unique solution, so no uniqueness probe is needed.
+ */
+static bool grid_reduce_to_difficulty(grid_t *grid, const size_t difficulty,
+                                      prng_t *prng) {
+
+  removal_t *removal = grid_removal_alloc(grid, prng);
+  if (removal == NULL) {
+    errx(EXIT_FAILURE, "error: Error while allocating removal schedule\n");
+  }
+
+  choice_t *choice;
+  while ((choice = grid_removal_next(removal, grid)) != NULL) {
+
+    if (grid_difficulty(grid, difficulty) > difficulty ||
+        (difficulty == MAX_DIFFICULTY && !grid_is_unique(grid))) {
+      grid_removal_restore(removal, grid, choice);
+    }
+    grid_choice_free(choice);
+  }
+
+  grid_removal_free(removal);
+
+  return grid_difficulty(grid, difficulty) == difficulty;
+}
+
+/* Generate a grid with the given options, all random draws come from `prng` */
+static grid_t *grid_generator(const generator_options_t *options,
+                              prng_t *prng) {
+
+  size_t size = options->size;
+  bool is_unique_mode =
+      options->unique || options->minimal || options->difficulty != 0;
+  size_t nb_solutions = 0;
+
+  /* The search does not fill the largest grids in a reasonable time, and
+   * their snapshots would grow toward size^4 cells */
+  if (size > MAX_SEARCHED_GENERATOR_SIZE) {
+    grid_t *grid = get_new_solved_grid(size, prng);
+    remove_some_colors(grid, ceil(size * size * PATTERN_EMPTY_CELLS_RATE),
+                       prng);
+    return grid;
+  }
+
+  grid_t *grid = get_new_grid(size, prng);
+  size_t limit = is_unique_mode ? 2 : 1;
+  grid_solver_for_generator(grid, limit, &nb_solutions);
+
+  if (options->difficulty != 0) {
+    /* Grids ending easier than requested are discarded */
+    size_t nb_attempts = 1;
+
+    while (!grid_reduce_to_difficulty(grid, options->difficulty, prng)) {
+
+      if (nb_attempts++ == MAX_DIFFICULTY_ATTEMPTS) {
+        errx(EXIT_FAILURE,
+             "error: no grid of difficulty %zu found after %d attempts",
+             options->difficulty, MAX_DIFFICULTY_ATTEMPTS);
+      }
+
+      grid_free(grid);
+      grid = get_new_grid(size, prng);
+      grid_solver_for_generator(grid, limit, &nb_solutions);
+    }
+  } else if (options->minimal) {
+    grid_minimize(grid, options->nb_threads, prng);
+  } else if (!is_unique_mode) {
+    size_t nb_colors_to_remove = ceil(size * size * EMPTY_CELLS_RATE);
+    remove_some_colors(grid, nb_colors_to_remove, prng);
+  } else {
+
+    removal_t *removal = grid_removal_alloc(grid, prng);
+    if (removal == NULL) {
+      errx(EXIT_FAILURE, "error: Error while allocating removal schedule\n");
+    }
+
+    size_t nb_color_removed = 0;
+    size_t nb_color_to_remove = grid->size * grid->size * EMPTY_CELLS_RATE;
+    choice_t *choice;
+
+    while (nb_color_removed < nb_color_to_remove &&
+           (choice = grid_removal_next(removal, grid)) != NULL) {
+
+      grid_t *grid_cpy = grid_copy(grid);
+      if (grid_cpy == NULL) {
+        errx(EXIT_FAILURE, "error: Error while doing a deep code of grid\n");
+      }
+
+      nb_solutions = 0;
+      grid_solver_for_generator(grid_cpy, 2, &nb_solutions);
+
+      if (nb_solutions == 1) {
+        nb_color_removed++;
+      } else {
+        grid_removal_restore(removal, grid, choice);
+      }
+      grid_choice_free(choice);
+      grid_free(grid_cpy);
+    }
+
+    grid_removal_free(removal);
+  }
+
+  return grid;
+}
+
+/* Grids of a batch being generated by several threads */
+typedef struct {
+  grid_t **grids;     /* Generated grids, in output order */
+  size_t first;       /* Index of `grids[0]` in the whole batch */
+  size_t nb_grids;    /* Number of grids to generate in this chunk */
+  atomic_size_t next; /* Next grid of the chunk to be generated */
+  uint64_t seed;
+  generator_options_t options;
+} batch_t;
+
+/* Generate grids of the batch until none is left. Grid `i` is always drawn
+ * from the stream `i` of the seed, whatever the thread running it. */
+static void *batch_worker(void *arg) {
+
+  batch_t *batch = arg;
+  size_t i;
+
+  while ((i = atomic_fetch_add(&batch->next, 1)) < batch->nb_grids) {
+    prng_t prng;
+    prng_seed(&prng, batch->seed, batch->first + i);
+    batch->grids[i] = grid_generator(&batch->options, &prng);
+  }
+
+  return NULL;
+}
+
+/* Generate `nb_grids` grids with `nb_threads` threads and write them in order
+ * to `fd` as soon as each chunk is complete */
+static void batch_generator(const generator_options_t *options,
+                            const size_t nb_grids, size_t nb_threads,
+                            const uint64_t seed, FILE *fd) {
+
+  size_t chunk_size = GRIDS_PER_THREAD_AND_CHUNK * nb_threads;
+  pthread_t *threads = malloc(nb_threads * sizeof(pthread_t));
+  batch_t batch = {.seed = seed, .options = *options};
+
+  if (threads == NULL) {
+    errx(EXIT_FAILURE, "error: Error while allocating generator threads");
+  }
+
+  /* A single grid gets all the threads to probe its removals */
+  if (nb_grids > 1) {
+    batch.options.nb_threads = 1;
+  } else {
+    batch.options.nb_threads = nb_threads;
+    nb_threads = 1;
+  }
+
+  batch.grids = malloc(chunk_size * sizeof(grid_t *));
+  if (batch.grids == NULL) {
+    errx(EXIT_FAILURE, "error: Error while allocating the batch of grids");
+  }
+
+  for (batch.first = 0; batch.first < nb_grids; batch.first += chunk_size) {
+
+    batch.nb_grids = nb_grids - batch.first < chunk_size
+                         ? nb_grids - batch.first
+                         : chunk_size;
+    atomic_init(&batch.next, 0);
+
+    for (size_t t = 1; t < nb_threads; t++) {
+      if (pthread_create(&threads[t], NULL, batch_worker, &batch) != 0) {
+        errx(EXIT_FAILURE, "error: Error while creating generator threads");
+      }
+    }
+    batch_worker(&batch);
+    for (size_t t = 1; t < nb_threads; t++) {
+      pthread_join(threads[t], NULL);
+    }
+
+    for (size_t i = 0; i < batch.nb_grids; i++) {
+      if (nb_grids > 1) {
+        fprintf(fd, "# Grid %zu\n", batch.first + i + 1);
+      }
+      grid_print(batch.grids[i], fd);
+      if (nb_grids > 1) {
+        fprintf(fd, "\n");
+      }
+      grid_free(batch.grids[i]);
+    }
+    fflush(fd);
+  }
+
+  free(batch.grids);
+  free(threads);
+}
+
+/* Print the number of solutions of a grid, return False if there is none */
+static bool solver_report(const count_t nb_solutions, FILE *fd) {
+
+  if (nb_solutions == 0) {
+    warnx("The grid is inconsistent!\n");
+    return false;
+  }
+
+  fputs(SOLUTIONS_REPORT, fd);
+  count_print(nb_solutions, fd);
+  fputs("\n", fd);
+  fprintf(fd, "The grid is solved!\n");
+
+  return true;
+}
+
+/* Close the output file given by '-o', stdout is left to exit() */
+static void output_close(FILE *fd) {
+
+  if (fd != stdout) {
+    fclose(fd);
+  }
+}
+
+/* Parse a non-negative integer option, or exit with an error */
+static unsigned long long parse_number_option(const char *name,
+                                              const char *value) {
+
+  char *end;
+  unsigned long long res = strtoull(value, &end, 10);
+
+  if (*value == '\0' || *value == '-' || *end != '\0') {
+    errx(EXIT_FAILURE, "error: invalid value '%s' for option '%s'", value,
+         name);
+  }
+
+  return res;
+}
+
+/* Parse a strictly positive integer option, or exit with an error */
+static unsigned long long parse_positive_option(const char *name,
+                                                const char *value) {
+
+  unsigned long long res = parse_number_option(name, value);
+
+  if (res == 0) {
+    errx(EXIT_FAILURE, "error: invalid value '%s' for option '%s'", value,
+         name);
+  }
+
+  return res;
+}
+
+/* Parse a strictly positive real option, or exit with an error */
+static double parse_real_option(const char *name, const char *value) {
+
+  char *end;
+  double res = strtod(value, &end);
+
+  if (*value == '\0' || *end != '\0' || !isfinite(res) || res <= 0) {
+    errx(EXIT_FAILURE, "error: invalid value '%s' for option '%s'", value,
+         name);
+  }
+
+  return res;
+}
+
+int main(int argc, char *argv[]) {
+
+  const char *help_msg =
+      "Usage:  sudoku [-a| --count| --limit N| -o FILE| -v| -V| -h] FILE...\n"
+      "\tsudoku --split-depth D --emit-shards DIR FILE\n"
+      "\tsudoku --merge FILE...\n"
+      "\tsudoku -g[SIZE] [-u| -m| -d N| -n N| -t N| -s N| -o FILE| -v| -V| -h]\n"
+      "Solve or generate Sudoku grids of various sizes "
+      "(" GRID_SIZES ")\n\n"
+      "-a, -all\t\t search for all possible solutions\n"
+      "-g[N], --generate[=N]\t generate a grid of size N*N "
+      "(default:9)\n"
+      "-u, --unique\t\t generate a grid with unique solution\n"
+      "-m, --minimal\t\t generate a unique grid where every clue is needed\n"
+      "-d N, --difficulty N\t generate a unique grid of difficulty N (1-5)\n"
+      "-n N, --number=N\t generate a batch of N grids (default:1)\n"
+      "-t N, --threads N\t generate the batch with N threads (default:1)\n"
+      "-s N, --seed N\t\t seed of the generator (default:random)\n"
+      "--subset-order N\t largest naked/hidden subsets looked for "
+      "(default:4)\n"
+      "--all-different\t\t use a matching filter instead of the subsets\n"
+      "--bitboard\t\t propagate the root on per-color bitboards first\n"
+      "--schedule P\t\t run every technique ('full') or skip the costly "
+      "ones ('adaptive') (default:full)\n"
+      "--fish N\t\t largest fishes looked for, 0 to disable (default:4)\n"
+      "--finned\t\t also look for finned fishes\n"
+      "--chains N\t\t longest chains looked for, 0 to disable (default:0)\n"
+      "--chain-budget MS\t time given to chains when stuck (default:2)\n"
+      "--probe[=N]\t\t try up to N assignments before each choice "
+      "(default:128)\n"
+      "--count\t\t\t only count the solutions, without printing them\n"
+      "--limit N\t\t stop after N solutions (2 checks uniqueness)\n"
+      "--factor\t\t only count the solutions, region by region\n"
+      "--backjump\t\t jump back to the cause of each failure\n"
+      "--nogoods N\t\t failures remembered by --backjump (default:256)\n"
+      "--checkpoint FILE\t save the search in FILE from time to time\n"
+      "--checkpoint-interval S  seconds between two checkpoints "
+      "(default:600)\n"
+      "--resume FILE\t\t continue the search saved in FILE with its "
+      "options\n"
+      "--split-depth D\t\t cut the search after D choices into shards\n"
+      "--emit-shards DIR\t write the shards of --split-depth in DIR\n"
+      "--solve-shard FILE\t count the solutions of the shard FILE\n"
+      "--merge\t\t\t sum the counts reported in the output FILEs\n"
+      "--progress[=S]\t\t report the search on stderr every S seconds "
+      "(default:5)\n"
+      "--tt-mb N\t\t keep a table of explored states of N MB "
+      "(default:0, off)\n"
+      "-o FILE, --output FILE\t write solution to File\n"
+      "-v, --verbose\t\t verbose output\n"
+      "-V, --version\t\t display version and exit\n"
+      "-h, --help\t\t display this help and exit";
+
+  bool unique = false;
+  bool minimal = false;
+  size_t difficulty = 0;
+  size_t tt_megabytes = DEFAULT_TT_MEGABYTES;
+  bool all = false;
+  bool factor = false;
+  bool count_only = false;
+  const char *resume_file = NULL;
+  bool solve_shard = false;
+  size_t split_depth = 0;
+  const char *shard_directory = NULL;
+  bool merge = false;
+  bool generate = false;
+
+  int grid_size = GRID_DEFAULT_SIZE;
+  size_t nb_grids = 1;
+  size_t nb_threads = 1;
+  uint64_t seed = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+
+  FILE *program_output = stdout;
+  char *output_file_name = NULL;
+
+  const struct option long_opts[] = {{"all", no_argument, NULL, 'a'},
+                                     {"generate", optional_argument, NULL, 'g'},
+                                     {"unique", no_argument, NULL, 'u'},
+                                     {"minimal", no_argument, NULL, 'm'},
+                                     {"difficulty", required_argument, NULL,
+                                      'd'},
+                                     {"number", required_argument, NULL, 'n'},
+                                     {"count", no_argument, NULL, option_count},
+                                     {"limit", required_argument, NULL,
+                                      option_limit},
+                                     {"threads", required_argument, NULL, 't'},
+                                     {"seed", required_argument, NULL, 's'},
+                                     {"subset-order", required_argument, NULL,
+                                      option_subset_order},
+                                     {"all-different", no_argument, NULL,
+                                      option_all_different},
+                                     {"bitboard", no_argument, NULL,
+                                      option_bitboard},
+                                     {"schedule", required_argument, NULL,
+                                      option_schedule},
+                                     {"fish", required_argument, NULL,
+                                      option_fish},
+                                     {"finned", no_argument, NULL,
+                                      option_finned},
+                                     {"chains", required_argument, NULL,
+                                      option_chains},
+                                     {"chain-budget", required_argument, NULL,
+                                      option_chain_budget},
+                                     {"probe", optional_argument, NULL,
+                                      option_probe},
+                                     {"factor", no_argument, NULL,
+                                      option_factor},
+                                     {"backjump", no_argument, NULL,
+                                      option_backjump},
+                                     {"nogoods", required_argument, NULL,
+                                      option_nogoods},
+                                     {"checkpoint", required_argument, NULL,
+                                      option_checkpoint},
+                                     {"checkpoint-interval", required_argument,
+                                      NULL, option_checkpoint_interval},
+                                     {"resume", required_argument, NULL,
+                                      option_resume},
+                                     {"split-depth", required_argument, NULL,
+                                      option_split_depth},
+                                     {"emit-shards", required_argument, NULL,
+                                      option_emit_shards},
+                                     {"solve-shard", required_argument, NULL,
+                                      option_solve_shard},
+                                     {"merge", no_argument, NULL,
+                                      option_merge},
+                                     {"progress", optional_argument, NULL,
+                                      option_progress},
+                                     {"tt-mb", required_argument, NULL,
+                                      option_tt_mb},
+                                     {"output", required_argument, NULL, 'o'},
+                                     {"verbose", no_argument, NULL, 'v'},
+                                     {"version", no_argument, NULL, 'V'},
+                                     {"help", no_argument, NULL, 'h'},
+                                     {NULL, no_argument, NULL, no_argument}};
+
+  solver_options = default_solver_options;
+
+  int optc;
+  while ((optc = getopt_long(argc, argv, "ag::umd:n:t:s:o:vVh", long_opts, NULL)) !=
+         -1) {
+
+    switch (optc) {
+    case 'h':
+      fputs(help_msg, stdout);
+      exit(EXIT_SUCCESS);
+
+    case 'V':
+      fprintf(stdout, "sudoku %d.%d.%d\n", VERSION, SUBVERSION, REVISION);
+      fputs("Solve or generate sudoku grids "
+            "(possible sizes: " GRID_SIZES ")\n",
+            stdout);
+      exit(EXIT_SUCCESS);
+
+    case 'v':
+      verbose = true;
+      break;
+
+    case option_subset_order:
+      solver_options.subset_order =
+          parse_positive_option("subset-order", optarg);
+      break;
+
+    case option_all_different:
+      solver_options.all_different = true;
+      break;
+
+    case option_bitboard:
+      use_bitboard = true;
+      break;
+
+    case option_schedule:
+      if (strcmp(optarg, "full") == 0) {
+        solver_options.schedule = schedule_full;
+      } else if (strcmp(optarg, "adaptive") == 0) {
+        solver_options.schedule = schedule_adaptive;
+      } else {
+        errx(EXIT_FAILURE, "error: invalid value '%s' for option 'schedule'",
+             optarg);
+      }
+      break;
+
+    case option_factor:
+      factor = true;
+      break;
+
+    case option_backjump:
+      solver_options.backjump = true;
+      break;
+
+    case option_nogoods:
+      backjump_max_nogoods = parse_number_option("nogoods", optarg);
+      break;
+
+    case option_checkpoint:
+      checkpoint_file = optarg;
+      break;
+
+    case option_checkpoint_interval:
+      checkpoint_interval =
+          parse_positive_option("checkpoint-interval", optarg);
+      break;
+
+    case option_resume:
+      resume_file = optarg;
+      break;
+
+    case option_split_depth:
+      split_depth = parse_positive_option("split-depth", optarg);
+      break;
+
+    case option_emit_shards:
+      shard_directory = optarg;
+      break;
+
+    case option_solve_shard:
+      /* A shard is a checkpoint, its solutions are counted by default */
+      resume_file = optarg;
+      solve_shard = true;
+      break;
+
+    case option_merge:
+      merge = true;
+      break;
+
+    case option_progress:
+      progress_interval = (optarg == NULL)
+                              ? DEFAULT_PROGRESS_INTERVAL
+                              : parse_positive_option("progress", optarg);
+      break;
+
+    case option_tt_mb:
+      tt_megabytes = parse_number_option("tt-mb", optarg);
+      break;
+
+    case option_fish:
+      solver_options.fish = parse_number_option("fish", optarg);
+      break;
+
+    case option_finned:
+      solver_options.finned = true;
+      break;
+
+    case option_chains:
+      solver_options.chains = parse_number_option("chains", optarg);
+      if (solver_options.chains > MAX_CHAIN_LENGTH) {
+        errx(EXIT_FAILURE, "error: chains must be at most %d",
+             MAX_CHAIN_LENGTH);
+      }
+      break;
+
+    case option_chain_budget:
+      solver_options.chain_budget = parse_real_option("chain-budget", optarg);
+      break;
+
+    case option_probe:
+      solver_options.probe = (optarg == NULL)
+                                 ? DEFAULT_PROBE_BUDGET
+                                 : parse_positive_option("probe", optarg);
+      break;
+
+    case 'o':
+      output_file_name = optarg;
+
+      break;
+
+    case 'a':
+      all = true;
+      break;
+
+    case 'g':
+      generate = true;
+
+      if (optarg) {
+        grid_size = atoi(optarg);
+
+#ifndef COLORS_WIDE
+        if (grid_size == 81 || grid_size == 100) {
+          wide_exec(argv);
+        }
+#endif
+
+        if (!grid_check_size(grid_size)) {
+          errx(EXIT_FAILURE,
+               "error: invalid grid size '%d'. \n"
+               "Possible sizes: " GRID_SIZES ".",
+               grid_size);
+        }
+      }
+      break;
+
+    case 'u':
+      unique = true;
+      break;
+
+    case 'm':
+      minimal = true;
+      break;
+
+    case 'd':
+      difficulty = parse_positive_option("difficulty", optarg);
+
+      if (difficulty > MAX_DIFFICULTY) {
+        errx(EXIT_FAILURE,
+             "error: invalid difficulty '%zu'.\n"
+             "Possible difficulties: 1 to %d.",
+             difficulty, MAX_DIFFICULTY);
+      }
+      break;
+
+    case option_count:
+      count_only = true;
+      break;
+
+    case 'n':
+      nb_grids = parse_positive_option("number", optarg);
+      break;
+
+    case option_limit:
+      solver_options.limit = parse_positive_option("limit", optarg);
+      break;
+
+    case 't':
+      nb_threads = parse_positive_option("threads", optarg);
+      if (nb_threads > MAX_THREADS) {
+        errx(EXIT_FAILURE, "error: threads must be at most %d", MAX_THREADS);
+      }
+      break;
+
+    case 's':
+      seed = parse_number_option("seed", optarg);
+      break;
+
+    default:
+      errx(EXIT_FAILURE, "error: invalid option '%s'\nCheck './sudoku -h' !",
+           argv[optind - 1]);
+    }
+  }
+
+  solver_options_apply(&solver_options);
+
+  if (output_file_name != NULL) {
+    program_output = fopen(output_file_name, "w+");
+  }
+
+  if (program_output == NULL) {
+    errx(EXIT_FAILURE, "error: Error while opening file %s",
+         output_file_name);
+  }
+
+  if (generate) {
+    if (grid_size > MAX_SEARCHED_GENERATOR_SIZE &&
+        (unique || minimal || difficulty != 0)) {
+      errx(EXIT_FAILURE, "error: options 'unique', 'minimal' and 'difficulty' "
+                         "go up to %dx%d grids",
+           MAX_SEARCHED_GENERATOR_SIZE, MAX_SEARCHED_GENERATOR_SIZE);
+    }
+
+    fprintf(program_output, "# Generator mode \n");
+    fprintf(program_output, "# Seed %llu\n", (unsigned long long)seed);
+
+    generator_options_t options = {
+        .size = grid_size,
+        .unique = unique,
+        .minimal = minimal,
+        .difficulty = difficulty};
+
+    batch_generator(&options, nb_grids, nb_threads, seed, program_output);
+    output_close(program_output);
+    return EXIT_SUCCESS;
+  }
+
+  if (unique) {
+    unique = false;
+    warnx("warning: option 'unique' conflict with solver mode, disabling it!");
+  }
+
+  if (minimal) {
+    minimal = false;
+    warnx("warning: option 'minimal' conflict with solver mode, disabling it!");
+  }
+
+  if (optind == argc && resume_file == NULL) {
+    errx(EXIT_FAILURE, "error: no input grid given!");
+  }
+
+  /* Check if files are readable */
+  for (int i = optind; i < argc; i++) {
+
+    if (access(argv[i], R_OK) != 0) {
+      errx(EXIT_FAILURE, "error: file '%s' is not readeable or do not exist!",
+           argv[i]);
+    }
+  }
+
+#ifndef COLORS_WIDE
+  /* The grids above 64x64 are left to the wide build */
+  bool need_wide =
+      resume_file != NULL && checkpoint_size(resume_file) > MAX_GRID_SIZE;
+  for (int i = optind; i < argc && !need_wide && !merge; i++) {
+    need_wide = file_first_row_words(argv[i]) > MAX_GRID_SIZE;
+  }
+  if (need_wide) {
+    wide_exec(argv);
+  }
+#endif
+
+  if (merge) {
+    count_t total = 0;
+
+    for (int i = optind; i < argc; i++) {
+      if (merge_file(argv[i], &total) == 0) {
+        errx(EXIT_FAILURE, "error: no number of solutions in '%s'", argv[i]);
+      }
+    }
+
+    fputs(SOLUTIONS_REPORT, program_output);
+    count_print(total, program_output);
+    fputs("\n", program_output);
+
+    output_close(program_output);
+    return EXIT_SUCCESS;
+  }
+
+  if (split_depth != 0 || shard_directory != NULL) {
+    if (split_depth == 0 || shard_directory == NULL) {
+      errx(EXIT_FAILURE, "error: options 'split-depth' and 'emit-shards' go "
+                         "together");
+    }
+    if (argc - optind != 1 || resume_file != NULL) {
+      errx(EXIT_FAILURE, "error: option 'split-depth' needs a single grid");
+    }
+
+    grid_t *grid = file_parser(argv[optind]);
+    if (grid == NULL || !grid_is_consistent(grid)) {
+      errx(EXIT_FAILURE, "error: Initial grid is inconsistent or not valid");
+    }
+
+    /* The shards are counted */
+    solver_options.mode = mode_count;
+    size_t nb_shards = grid_split(grid, split_depth, shard_directory);
+    fprintf(program_output, "# Number of shards: %zu\n", nb_shards);
+    grid_free(grid);
+
+    output_close(program_output);
+    return EXIT_SUCCESS;
+  }
+
+  /* Only the solver looks its states up, the generator, the merge and the
+   * split go without a table */
+  if (tt_megabytes != 0) {
+    solver_tt = tt_alloc(tt_megabytes);
+    if (solver_tt == NULL) {
+      errx(EXIT_FAILURE, "error: Error while allocating %zu MB for the table",
+           tt_megabytes);
+    }
+  }
+
+  if (progress_interval != 0 && factor) {
+    errx(EXIT_FAILURE, "error: option 'progress' conflict with option "
+                       "'factor'");
+  }
+
+  if (checkpoint_file != NULL) {
+    if (factor) {
+      errx(EXIT_FAILURE, "error: option 'checkpoint' conflict with option "
+                         "'factor'");
+    }
+    if (argc - optind + (resume_file != NULL) > 1) {
+      errx(EXIT_FAILURE, "error: option 'checkpoint' needs a single grid");
+    }
+
+    signal(SIGINT, checkpoint_on_signal);
+    signal(SIGTERM, checkpoint_on_signal);
+  }
+
+  if (solve_shard && !all) {
+    count_only = true;
+  }
+
+  solver_options.mode = count_only ? mode_count : all ? mode_all : mode_first;
+
+  checkpoint_t checkpoint;
+  if (resume_file != NULL) {
+    checkpoint_read(&checkpoint, resume_file);
+    solver_options_resume(&checkpoint);
+  }
+
+  /* Without a limit, the first solution stops the default mode */
+  if (solver_options.mode == mode_first && solver_options.limit == 0) {
+    solver_options.limit = 1;
+  }
+
+  solver_options_apply(&solver_options);
+  mode_t mode = solver_options.mode;
+
+  fprintf(program_output, "---Solveur mode---\n");
+
+  bool are_all_grids_consistent = true;
+
+  if (resume_file != NULL) {
+    fprintf(program_output, "------Grid 1: %s--------\n", resume_file);
+    grid_solver_resume(&checkpoint, mode, program_output);
+    if (solve_shard && count_solved_grid == 0) {
+      /* An empty shard is a result to merge, not an error */
+      fputs(SOLUTIONS_REPORT "0\n", program_output);
+    } else {
+      are_all_grids_consistent &=
+          solver_report(count_solved_grid, program_output);
+    }
+    fprintf(program_output, "-------------------\n");
+
+    grid_free(checkpoint.root);
+    free(checkpoint.decisions);
+    free(checkpoint.solutions_before);
+  }
+
+  for (int i = optind; i < argc; i++) {
 
     fprintf(program_output, "------Grid %d: %s--------\n", i - optind + 1,
             argv[i]);
 
     grid_t *grid = file_parser(argv[i]);
+    grid_schedule_reset();
 
     if ((grid != NULL) && grid_is_consistent(grid)) {
 
-      count_solved_grid = 0;
-      grid_solver(grid, all ? mode_all : mode_first, program_output);
-      grid_free(grid);
-
-      if (count_solved_grid != 0) {
-
-        fprintf(program_output, "# Number of solutions: %ld\n",
-                count_solved_grid);
-        fprintf(program_output, "The grid is solved!\n");
-        are_all_grids_consistent &= true;
+      count_t nb_solutions;
 
+      count_solved_grid = 0;
+      if (factor) {
+        nb_solutions = grid_count_by_regions(grid);
       } else {
-        warnx("The grid is inconsistent!\n");
-        are_all_grids_consistent &= false;
+        grid_solver(grid, mode, program_output);
+        nb_solutions = count_solved_grid;
       }
+      grid_free(grid);
+
+      are_all_grids_consistent &= solver_report(nb_solutions, program_output);
 
     } else {
 
@@ -522,7 +3417,8 @@ int main(int argc, char *argv[]) {
     fprintf(program_output, "-------------------\n");
   }
 
-  fclose(program_output);
+  tt_free(solver_tt);
+  output_close(program_output);
 
   return are_all_grids_consistent ? EXIT_SUCCESS : EXIT_FAILURE;
 }
\ No newline at end of file
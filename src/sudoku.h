@@ -5,7 +5,22 @@
 #define SUBVERSION 0
 #define REVISION 0
 
-typedef enum { mode_first, mode_all } mode_t;
-typedef enum { mode_unique, mode_not_unique } generator_t;
+#include <stdbool.h>
+#include <stdlib.h>
+
+/* Solver modes, mode_count enumerates the solutions without printing them */
+typedef enum { mode_first, mode_all, mode_count } mode_t;
+
+/* Number of solutions, products of regions counts overflow 64 bits */
+__extension__ typedef unsigned __int128 count_t;
+
+/* Options of the generator, shared by all the grids of a batch */
+typedef struct {
+  size_t size;
+  bool unique;
+  bool minimal;      /* Remove clues until each one is necessary */
+  size_t difficulty; /* Difficulty level (1 to 5) of the grids, 0 for any */
+  size_t nb_threads; /* Threads probing the removals of a minimal grid */
+} generator_options_t;
 
 #endif /* SUDOKU_H */
\ No newline at end of file
@@ -0,0 +1,68 @@
+#include "tt.h"
+
+tt_t *tt_alloc(const size_t megabytes) {
+
+  size_t nb_entries = (megabytes << 20) / sizeof(tt_entry_t);
+  if (nb_entries == 0) {
+    return NULL;
+  }
+
+  /* Round down to a power of two so that the index is a mask */
+  while ((nb_entries & (nb_entries - 1)) != 0) {
+    nb_entries &= nb_entries - 1;
+  }
+
+  tt_t *tt = malloc(sizeof(tt_t));
+  if (tt == NULL) {
+    return NULL;
+  }
+
+  /* An all-zero entry only matches the key and check 0 with the data 0 */
+  tt->entries = calloc(nb_entries, sizeof(tt_entry_t));
+  if (tt->entries == NULL) {
+    free(tt);
+    return NULL;
+  }
+  tt->mask = nb_entries - 1;
+
+  return tt;
+}
+
+void tt_free(tt_t *tt) {
+
+  if (tt == NULL) {
+    return;
+  }
+
+  free(tt->entries);
+  free(tt);
+}
+
+void tt_store(tt_t *tt, const uint64_t key, const uint64_t check,
+              const uint64_t data) {
+
+  tt_entry_t *entry = &tt->entries[key & tt->mask];
+
+  atomic_store_explicit(&entry->key, key ^ data, memory_order_relaxed);
+  atomic_store_explicit(&entry->check, check ^ data, memory_order_relaxed);
+  atomic_store_explicit(&entry->data, data, memory_order_relaxed);
+}
+
+bool tt_probe(const tt_t *tt, const uint64_t key, const uint64_t check,
+              uint64_t *data) {
+
+  tt_entry_t *entry = &tt->entries[key & tt->mask];
+
+  uint64_t key_word = atomic_load_explicit(&entry->key, memory_order_relaxed);
+  uint64_t check_word =
+      atomic_load_explicit(&entry->check, memory_order_relaxed);
+  uint64_t value = atomic_load_explicit(&entry->data, memory_order_relaxed);
+
+  if ((key_word ^ value) != key || (check_word ^ value) != check) {
+    return false;
+  }
+
+  *data = value;
+
+  return true;
+}
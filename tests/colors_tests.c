@@ -67,8 +67,13 @@ main (void)
 
   /* Has not been specified ! */
   EXPECT ((colors_full (17) == 131071), "colors_full(17) == [0,1, ... ,16]");
+#ifdef COLORS_WIDE
+  EXPECT ((colors_full (73) == ((colors_t) 511 << 64) + 18446744073709551615ULL),
+	  "colors_full(73) == [0,1, ... ,72]");
+#else
   EXPECT ((colors_full (73) == 18446744073709551615ULL),
 	  "colors_full(73) == [0,1, ... ,63]");
+#endif
 
   fputs ("\n", stdout);
 
@@ -95,7 +100,12 @@ main (void)
   EXPECT ((colors_set (63) == 9223372036854775808ULL), "colors_set(63) == [63]");
 
   /* Has not been specified */
+#ifdef COLORS_WIDE
+  EXPECT ((colors_set (79) == (colors_t) 32768 << 64), "colors_set (79) == [79]");
+  EXPECT ((colors_set (131) == 0), "colors_set (131) == []");
+#else
   EXPECT ((colors_set (79) == 0), "colors_set (79) == []");
+#endif
 
   fputs ("\n", stdout);
 
@@ -119,10 +129,16 @@ main (void)
 	  "colors_add(colors_add(colors_set(4), 27), 27) == [4,27]");
 
   /* Has not been specified ! */
+#ifdef COLORS_WIDE
+  EXPECT ((colors_add (colors_add (colors_set (4), 27), 79)
+	   == ((colors_t) 32768 << 64) + 134217744),
+	  "colors_add(colors_add(colors_set(4), 27), 79) == [4,27,79]");
+#else
   EXPECT ((colors_add (colors_add (colors_set (4), 27), 79) == 134217744),
 	  "colors_add(colors_add(colors_set(4), 27), 79) == [4,27]");
   EXPECT ((colors_add (colors_add (colors_set (4), 47), 79) == 140737488355344ULL),
 	  "colors_add(colors_add(colors_set(4), 47), 79) == [4,47]");
+#endif
 
   fputs ("\n", stdout);
 
@@ -225,6 +241,19 @@ main (void)
   fputs ("colors_negate\n"
 	 "=============\n", stdout);
 
+#ifdef COLORS_WIDE
+  /* The high word of the wide sets is negated too */
+  EXPECT ((colors_negate (colors_full (9))
+	   == ((colors_t) 18446744073709551615ULL << 64) + 18446744073709551104ULL),
+	  "colors_negate ([0,1, ... ,8])");
+
+  EXPECT ((colors_negate (colors_full (64))
+	   == (colors_t) 18446744073709551615ULL << 64),
+	  "colors_negate ([0,1, ... ,63]) == [64,65, ... ,127]");
+
+  EXPECT ((colors_negate (colors_full (128)) == 0),
+	  "colors_negate ([0,1, ... ,127]) == []");
+#else
   EXPECT ((colors_negate (colors_full (9)) == 18446744073709551104ULL),
 	  "colors_negate ([0,1, ... ,8])");
 
@@ -239,6 +268,7 @@ main (void)
 
   EXPECT ((colors_negate (colors_full (64)) == 0),
 	  "colors_negate ([0,1, ... ,63]) == []");
+#endif
 
   fputs ("\n", stdout);
 
@@ -523,8 +553,15 @@ main (void)
 	  "colors_count(colors_full(52)) == 52");
   EXPECT (((colors_count (colors_full(64)) == 64)),
 	  "colors_count(colors_full(64)) == 64");
+#ifdef COLORS_WIDE
+  EXPECT (((colors_count (colors_full(73)) == 73)),
+	  "colors_count(colors_full(73)) == 73");
+  EXPECT (((colors_count (colors_full(100)) == 100)),
+	  "colors_count(colors_full(100)) == 100");
+#else
   EXPECT (((colors_count (colors_full(73)) == 64)),
 	  "colors_count(colors_full(73)) == 64");
+#endif
 
   EXPECT (((colors_count (colors_set(0)) == 1)),
 	  "colors_count(colors_set(0)) == 1");
@@ -539,8 +576,13 @@ main (void)
   EXPECT (((colors_count (colors_set(63)) == 1)),
 	  "colors_count(colors_set(63)) == 1");
 
+#ifdef COLORS_WIDE
+  EXPECT (((colors_count (colors_set(67)) == 1)),
+	  "colors_count(colors_set(67)) == 1");
+#else
   EXPECT (((colors_count (colors_set(67)) == 0)),
 	  "colors_count(colors_set(67)) == 0");
+#endif
 
   EXPECT (((colors_count (colors_empty()) == 0)),
 	  "colors_count(colors_empty()) == 0");
@@ -616,25 +658,28 @@ main (void)
   fputs ("colors_random\n"
 	 "===============\n", stdout);
 
-  EXPECT ((colors_random (colors_empty ()) == colors_empty ()),
+  prng_t prng;
+  prng_seed (&prng, 42, 0);
+
+  EXPECT ((colors_random (colors_empty (), &prng) == colors_empty ()),
 	  "colors_random ([]) == []");
 
-  EXPECT ((colors_random (colors_set (0)) == colors_set (0)),
+  EXPECT ((colors_random (colors_set (0), &prng) == colors_set (0)),
 	  "colors_random ([0]) == [0]");
 
-  EXPECT ((colors_random (colors_set (23)) == colors_set (23)),
+  EXPECT ((colors_random (colors_set (23), &prng) == colors_set (23)),
 	  "colors_random ([23]) == [23]");
 
-  EXPECT ((colors_random (colors_set (43)) == colors_set (43)),
+  EXPECT ((colors_random (colors_set (43), &prng) == colors_set (43)),
 	  "colors_random ([43]) == [43]");
 
-  EXPECT ((colors_random (colors_set (63)) == colors_set (63)),
+  EXPECT ((colors_random (colors_set (63), &prng) == colors_set (63)),
 	  "colors_random ([63]) == [63]");
 
   /* p3 = [7,22,47] */
   p3 = colors_add (colors_add (colors_set (7), 22), 47);
 
-  colors_t random_color = colors_random (p3);
+  colors_t random_color = colors_random (p3, &prng);
   EXPECT ((random_color == colors_set (7)  ||
 	   random_color == colors_set (22) ||
 	   random_color == colors_set (47)),
@@ -642,5 +687,63 @@ main (void)
 
   fputs ("\n", stdout);
 
+  /* Testing naked_subset and hidden_subset */
+  /*****************************************/
+  fputs ("naked_subset and hidden_subset\n"
+	 "==============================\n", stdout);
+
+  /* [0,1] [0,1] [0,1,2] [0,1,2,3] : naked pair {0,1} */
+  colors_t cells[4];
+  colors_t *subgrid[4] = { &cells[0], &cells[1], &cells[2], &cells[3] };
+  cells[0] = colors_full (2);
+  cells[1] = colors_full (2);
+  cells[2] = colors_full (3);
+  cells[3] = colors_full (4);
+
+  EXPECT ((naked_subset (subgrid, 4)), "naked_subset ([0,1] [0,1] ...)");
+  EXPECT ((cells[2] == colors_set (2) && cells[3] == 12),
+	  "naked pair [0,1] removed from the other cells");
+
+  /* [0,1,2,3] [0,1,2,3] [0,1] [0,1] : hidden pair {2,3} */
+  cells[0] = colors_full (4);
+  cells[1] = colors_full (4);
+  cells[2] = colors_full (2);
+  cells[3] = colors_full (2);
+
+  EXPECT ((hidden_subset (subgrid, 4)), "hidden_subset (... [0,1] [0,1])");
+  EXPECT ((cells[0] == 12 && cells[1] == 12),
+	  "hidden pair [2,3] only keeps its colors");
+
+  EXPECT ((!hidden_subset (subgrid, 4)), "hidden_subset () at fixpoint");
+
+  fputs ("\n", stdout);
+
+  /* Testing all_different_check and all_different */
+  /*************************************************/
+  fputs ("all_different_check and all_different\n"
+	 "=====================================\n", stdout);
+
+  /* [0,1] [0,1] [0,1] [0,1,2,3] : three cells share two colors */
+  cells[0] = colors_full (2);
+  cells[1] = colors_full (2);
+  cells[2] = colors_full (2);
+  cells[3] = colors_full (4);
+
+  EXPECT ((!all_different_check (subgrid, 4)),
+	  "all_different_check ([0,1] [0,1] [0,1] ...) == false");
+
+  /* [0,1] [0,1] [0,1,2] [0,1,2,3] : only [2] then [3] are left */
+  cells[2] = colors_full (3);
+
+  EXPECT ((all_different_check (subgrid, 4)),
+	  "all_different_check ([0,1] [0,1] [0,1,2] ...) == true");
+  EXPECT ((all_different (subgrid, 4)), "all_different ([0,1] [0,1] ...)");
+  EXPECT ((cells[0] == 3 && cells[1] == 3 && cells[2] == colors_set (2) &&
+	   cells[3] == colors_set (3)),
+	  "all_different keeps the supported colors only");
+  EXPECT ((!all_different (subgrid, 4)), "all_different () at fixpoint");
+
+  fputs ("\n", stdout);
+
   return EXIT_SUCCESS;
 }
@@ -105,6 +105,29 @@ grid_tests (size_t size)
       }
   EXPECT ((is_equal), "grid == grid_copy(grid)");
 
+  /* Checking the hash follows the changes of the cells */
+  grid_t *grid3 = grid_alloc (size);
+  for (size_t i = grid_get_size (grid); i-- > 0;)
+    for (size_t j = grid_get_size (grid); j-- > 0;)
+      {
+	char *str = grid_get_cell (grid, i, j);
+	grid_set_cell (grid3, i, j, str[0]);
+	free (str);
+      }
+  grid_hash_t hash = grid_hash (grid);
+  grid_hash_t hash3 = grid_hash (grid3);
+  EXPECT ((hash.key == hash3.key && hash.check == hash3.check),
+	  "grid_hash() does not depend on the order of the writes");
+
+  if (size > 1)
+    {
+      grid_set_cell (grid3, 0, 0, EMPTY_CELL);
+      hash3 = grid_hash (grid3);
+      EXPECT ((hash.key != hash3.key && hash.check != hash3.check),
+	      "grid_hash() changes with the colors of a cell");
+    }
+  grid_free (grid3);
+
   EXPECT ((grid_get_cell (grid, size + 1, 0) == NULL),
 	  "grid_get_cell (grid, %zu, 0) == NULL", size + 1);
   EXPECT ((grid_get_cell (grid, 0, size + 1) == NULL),
@@ -134,6 +157,86 @@ grid_tests (size_t size)
   EXPECT ((is_equal),
 	  "no side effect on grid_set_cell(grid, size + 2, size / 2, '1')");
 
+  /* Checking the removal schedule visits every solved cell once */
+  prng_t prng;
+  prng_seed (&prng, size, 0);
+  removal_t *removal = grid_removal_alloc (grid2, &prng);
+  EXPECT ((removal), "grid_removal_alloc(grid) != NULL");
+
+  size_t nb_removed = 0;
+  choice_t *choice;
+  while ((choice = grid_removal_next (removal, grid2)) != NULL)
+    {
+      if (nb_removed % 2 == 0)
+	grid_removal_restore (removal, grid2, choice);
+      grid_choice_free (choice);
+      nb_removed++;
+    }
+  EXPECT ((nb_removed == size * size),
+	  "grid_removal_next() tried %zu cells", size * size);
+
+  grid_free (grid2);
+  grid2 = grid_copy (grid);
+  for (size_t i = 0; i < size * size; ++i)
+    if ((choice = grid_removal_next (removal, grid2)) != NULL)
+      grid_choice_free (choice);
+  EXPECT ((choice == NULL), "no cell tried twice by grid_removal_next()");
+  grid_removal_free (removal);
+
+  /* Checking grid_choice_assign() empties the color from the peers */
+  if (size >= 4)
+    {
+      colors_t cells[size * size];
+      for (size_t i = 0; i < size * size; ++i)
+	cells[i] = colors_full (size);
+      cells[0] = colors_full (2);
+      cells[size] = colors_full (2); /* Left with color 1 once assigned */
+      grid_set_colors (grid2, cells);
+
+      choice = grid_choice (grid2);
+      EXPECT ((grid_choice_assign (grid2, choice)),
+	      "grid_choice_assign(grid, choice) == true");
+      grid_choice_free (choice);
+      grid_get_colors (grid2, cells);
+
+      EXPECT ((cells[0] == colors_set (0) && cells[size] == colors_set (1)
+	       && cells[size + 1] == colors_full (size) - colors_full (2)
+	       && cells[size * size - size]
+		  == colors_full (size) - colors_full (2)),
+	      "grid_choice_assign() propagates to the peers");
+
+      /* Checking a choice emptying a peer leaves an inconsistent grid */
+      for (size_t i = 0; i < size * size; ++i)
+	cells[i] = colors_full (size);
+      cells[0] = colors_full (2);
+      cells[1] = colors_set (0); /* Emptied once the cell 0 gets color 0 */
+      grid_set_colors (grid2, cells);
+
+      choice = grid_choice (grid2);
+      EXPECT ((!grid_choice_assign (grid2, choice)),
+	      "grid_choice_assign(grid, choice) == false on an emptied peer");
+      grid_choice_free (choice);
+      EXPECT ((grid_heuristics (grid2, true) == 2),
+	      "grid_heuristics(grid) == 2 after an emptied peer");
+    }
+
+  /* Checking grid_unpack() gives back the grid stored by grid_pack() */
+  unsigned char packed[size * size * grid_cell_bytes (size)];
+  grid3 = grid_copy (grid);
+  grid_pack (grid2, packed);
+  grid_unpack (grid3, packed);
+
+  colors_t cells2[size * size], cells3[size * size];
+  grid_get_colors (grid2, cells2);
+  grid_get_colors (grid3, cells3);
+  grid_hash_t hash2 = grid_hash (grid2);
+  hash3 = grid_hash (grid3);
+  EXPECT ((memcmp (cells2, cells3, sizeof (cells2)) == 0
+	   && hash2.key == hash3.key && hash2.check == hash3.check),
+	  "grid_unpack(grid_pack(grid)) == grid in %zu-byte cells",
+	  grid_cell_bytes (size));
+  grid_free (grid3);
+
   /* Checking grid_free() */
   grid_free (grid);
   grid_free (grid2);
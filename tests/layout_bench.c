@@ -0,0 +1,160 @@
+#define _DEFAULT_SOURCE
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string.h>
+#include <time.h>
+
+#include <bitboard.h>
+#include <colors.h>
+#include <grid.h>
+
+/* Compare the layouts of the grids on the propagation they share: the
+ * singles and the locked candidates, without subsets and fishes. */
+
+/* Each layout runs at least this long on a grid */
+#define BENCH_SECONDS 0.2
+
+static double
+now (void)
+{
+  struct timespec now;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/* Read the grid of `filename`, only checked enough to not crash */
+static grid_t *
+read_grid (const char *filename)
+{
+  FILE *fd = fopen (filename, "r");
+  if (fd == NULL)
+    return NULL;
+
+  char tokens[MAX_GRID_SIZE * MAX_GRID_SIZE];
+  size_t nb_tokens = 0;
+  size_t first_row = 0;
+  int c;
+  bool comment = false;
+
+  while ((c = fgetc (fd)) != EOF && nb_tokens < sizeof (tokens))
+    {
+      if (c == '#')
+	comment = true;
+      else if (c == '\n')
+	{
+	  comment = false;
+	  if (first_row == 0)
+	    first_row = nb_tokens;
+	}
+      else if (!comment && c != ' ' && c != '\t' && c != '\r')
+	tokens[nb_tokens++] = c;
+    }
+  fclose (fd);
+
+  if (!grid_check_size (first_row) || nb_tokens != first_row * first_row)
+    return NULL;
+
+  grid_t *grid = grid_alloc (first_row);
+  if (grid == NULL)
+    return NULL;
+
+  for (size_t i = 0; i < nb_tokens; i++)
+    grid_set_cell (grid, i / first_row, i % first_row, tokens[i]);
+
+  return grid;
+}
+
+/* Run the propagation of `grid` on its row layout, return the time of one
+ * run in microseconds and leave the result in `result` */
+static double
+bench_cells (const grid_t *grid, uint64_t *result)
+{
+  grid_t *work = grid_copy (grid);
+  size_t nb_runs = 0;
+  double start = now ();
+  double end;
+
+  do
+    {
+      grid_deep_copy (work, (grid_t *) grid);
+      grid_heuristics (work, true);
+      nb_runs++;
+    }
+  while ((end = now ()) - start < BENCH_SECONDS);
+
+  grid_get_colors (work, result);
+  grid_free (work);
+
+  return (end - start) * 1e6 / nb_runs;
+}
+
+/* Same as bench_cells() on the bitboards, the loading is timed too */
+static double
+bench_bitboard (const grid_t *grid, uint64_t *result)
+{
+  size_t size = grid_get_size (grid);
+  bitboard_t *bitboard = bitboard_alloc (size);
+  uint64_t *cells = malloc (size * size * sizeof (uint64_t));
+  size_t nb_runs = 0;
+  double start = now ();
+  double end;
+
+  grid_get_colors (grid, cells);
+
+  do
+    {
+      bitboard_load (bitboard, cells);
+      bitboard_heuristics (bitboard, true);
+      nb_runs++;
+    }
+  while ((end = now ()) - start < BENCH_SECONDS);
+
+  bitboard_store (bitboard, result);
+  bitboard_free (bitboard);
+  free (cells);
+
+  return (end - start) * 1e6 / nb_runs;
+}
+
+int
+main (int argc, char *argv[])
+{
+  subset_set_max_order (1);
+  grid_set_fish (0, false);
+
+  fprintf (stdout, "%-44s %10s %12s %8s\n", "grid", "cells (us)",
+	   "bitboard (us)", "speedup");
+
+  for (int i = 1; i < argc; i++)
+    {
+      grid_t *grid = read_grid (argv[i]);
+      if (grid == NULL)
+	{
+	  fprintf (stderr, "layout_bench: cannot read '%s'\n", argv[i]);
+	  continue;
+	}
+
+      size_t size = grid_get_size (grid);
+      uint64_t *by_cells = malloc (size * size * sizeof (uint64_t));
+      uint64_t *by_bitboard = malloc (size * size * sizeof (uint64_t));
+
+      double cells_us = bench_cells (grid, by_cells);
+      double bitboard_us = bench_bitboard (grid, by_bitboard);
+      bool same = memcmp (by_cells, by_bitboard,
+			  size * size * sizeof (uint64_t)) == 0;
+
+      fprintf (stdout, "%-44s %10.1f %12.1f %7.2fx%s\n", argv[i], cells_us,
+	       bitboard_us, cells_us / bitboard_us,
+	       same ? "" : " (results differ!)");
+
+      free (by_cells);
+      free (by_bitboard);
+      grid_free (grid);
+    }
+
+  return EXIT_SUCCESS;
+}